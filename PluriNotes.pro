@@ -4,7 +4,7 @@
 #
 #-------------------------------------------------
 
-QT       += core gui sql multimedia multimediawidgets
+QT       += core gui sql multimedia multimediawidgets concurrent
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
@@ -40,7 +40,12 @@ SOURCES += main.cpp\
     relationtreeview.cpp \
     notesmanager.cpp \
     relationview.cpp \
-    datamanager.cpp
+    datamanager.cpp \
+    persistenceworker.cpp \
+    searchindex.cpp \
+    relationmodel.cpp \
+    relationtreemodel.cpp \
+    thumbnailservice.cpp
 
 HEADERS  += mainwindow.h \
     note.h \
@@ -57,7 +62,13 @@ HEADERS  += mainwindow.h \
     relationtreeview.h \
     datamanager.h \
     notesmanager.h \
-    relationview.h
+    relationview.h \
+    persistenceworker.h \
+    searchindex.h \
+    versionpool.h \
+    relationmodel.h \
+    relationtreemodel.h \
+    thumbnailservice.h
 
 RESOURCES += \
     res.qrc
@@ -1,12 +1,174 @@
 #include "datamanager.h"
 #include "notesmanager.h"
 
+/* The SQL statements used to write in the database. They are prepared once and kept by the SQLiteManager. */
+const QString SQL_DELETE_ARTICLE = "DELETE FROM Article WHERE id=:id;";
+const QString SQL_DELETE_MEDIA = "DELETE FROM Media WHERE id=:id;";
+const QString SQL_DELETE_TASK = "DELETE FROM Task WHERE id=:id;";
+const QString SQL_DELETE_NOTE = "DELETE FROM Note WHERE id=:id;";
+const QString SQL_INSERT_NOTE = "INSERT INTO Note (id, title,type,creationDateTime,state)"
+                                "VALUES (:id, :title,:type,:creationDateTime,:state);";
+const QString SQL_UPDATE_NOTE = "UPDATE Note SET title=:title,state=:state WHERE id=:id";
+const QString SQL_INSERT_ARTICLE = "INSERT INTO Article (id, modifDateTime, text)"
+                                   "VALUES (:id, :modifDateTime, :text);";
+const QString SQL_INSERT_MEDIA = "INSERT INTO Media (id, modifDateTime, description, filename)"
+                                 "VALUES(:id, :modifDateTime, :description, :filename);";
+const QString SQL_INSERT_TASK = "INSERT INTO Task (id, modifDateTime, action, status, priority, deadLine)"
+                                "VALUES (:id, :modifDateTime, :action, :status, :priority, :deadLine);";
+const QString SQL_INSERT_RELATION = "INSERT INTO Relation (name, description,isOriented) VALUES (:name, :description, :isOriented);";
+const QString SQL_UPDATE_RELATION = "UPDATE Relation SET description=:description,isOriented=:isOriented WHERE name=:name";
+const QString SQL_DELETE_COUPLE = "DELETE FROM Couple WHERE idAsc=:idAsc AND idDesc=:idDesc AND relation=:relation";
+const QString SQL_INSERT_COUPLE = "INSERT INTO Couple (idAsc,idDesc,relation,label) VALUES (:idAsc,:idDesc,:relation,:label);";
+const QString SQL_UPDATE_COUPLE = "UPDATE Couple SET label=:label WHERE idAsc=:idAsc AND idDesc=:idDesc AND relation=:relation;";
+
+/* The SQL statements used to load the versions. The 'ALL' ones read every version, the 'HEAD' ones only the most
+ recent version of each note (SQLite takes the bare columns from the row of the MAX) and the 'HISTORY' ones the
+ versions of a note older than a date. */
+const QString SQL_SELECT_ALL_ARTICLES = "SELECT id, modifDateTime, text FROM Article ORDER BY id, modifDateTime ASC;";
+const QString SQL_SELECT_HEAD_ARTICLES = "SELECT id, MAX(modifDateTime) AS modifDateTime, text FROM Article GROUP BY id;";
+const QString SQL_SELECT_HISTORY_ARTICLE = "SELECT modifDateTime, text FROM Article WHERE id=:id AND modifDateTime<:before ORDER BY modifDateTime DESC;";
+const QString SQL_SELECT_ALL_MEDIA = "SELECT id, modifDateTime, description, filename FROM Media ORDER BY id, modifDateTime ASC;";
+const QString SQL_SELECT_HEAD_MEDIA = "SELECT id, MAX(modifDateTime) AS modifDateTime, description, filename FROM Media GROUP BY id;";
+const QString SQL_SELECT_HISTORY_MEDIA = "SELECT modifDateTime, description, filename FROM Media WHERE id=:id AND modifDateTime<:before ORDER BY modifDateTime DESC;";
+const QString SQL_SELECT_ALL_TASKS = "SELECT id, modifDateTime, action, status, priority, deadLine FROM Task ORDER BY id, modifDateTime ASC;";
+const QString SQL_SELECT_HEAD_TASKS = "SELECT id, MAX(modifDateTime) AS modifDateTime, action, status, priority, deadLine FROM Task GROUP BY id;";
+const QString SQL_SELECT_HISTORY_TASK = "SELECT modifDateTime, action, status, priority, deadLine FROM Task WHERE id=:id AND modifDateTime<:before ORDER BY modifDateTime DESC;";
+
+/* The SQL statements used to load the notes, the relations and the couples. */
+const QString SQL_SELECT_NOTES = "SELECT id, title, type, creationDateTime, state FROM Note;";
+const QString SQL_SELECT_RELATIONS = "SELECT name, description, isOriented FROM Relation;";
+const QString SQL_SELECT_COUPLES_OF_RELATION = "SELECT idAsc, idDesc, label FROM Couple WHERE relation=:relation;";
+
+/* The SQL statements used to keep the full-text table NoteSearch in sync. It mirrors the title and the text of the
+ latest version of each note ; its rowid is the searchId given to the note in NoteSearchKey. The rowid of the Note
+ table can't be used : SQLite may renumber it on VACUUM, whereas an INTEGER PRIMARY KEY is kept. */
+const QString SQL_CREATE_NOTE_SEARCH = "CREATE VIRTUAL TABLE NoteSearch USING fts5(id UNINDEXED, title, content,"
+                                       " tokenize = 'unicode61 remove_diacritics 2');";
+const QString SQL_INSERT_NOTE_SEARCH_KEY = "INSERT OR IGNORE INTO NoteSearchKey (id) VALUES (:id);";
+const QString SQL_INSERT_NOTE_SEARCH = "INSERT OR REPLACE INTO NoteSearch (rowid, id, title, content)"
+                                       " SELECT NoteSearchKey.searchId, Note.id, Note.title, '' FROM Note"
+                                       " JOIN NoteSearchKey ON NoteSearchKey.id=Note.id WHERE Note.id=:id;";
+const QString SQL_UPDATE_NOTE_SEARCH_TITLE = "UPDATE NoteSearch SET title=:title WHERE rowid=(SELECT searchId FROM NoteSearchKey WHERE id=:id);";
+const QString SQL_UPDATE_NOTE_SEARCH_CONTENT = "UPDATE NoteSearch SET content=:content WHERE rowid=(SELECT searchId FROM NoteSearchKey WHERE id=:id);";
+const QString SQL_DELETE_NOTE_SEARCH = "DELETE FROM NoteSearch WHERE rowid=(SELECT searchId FROM NoteSearchKey WHERE id=:id);";
+const QString SQL_DELETE_NOTE_SEARCH_KEY = "DELETE FROM NoteSearchKey WHERE id=:id;";
+const QString SQL_SEARCH_NOTES = "SELECT id FROM NoteSearch WHERE NoteSearch MATCH :query"
+                                 " ORDER BY bm25(NoteSearch, 0.0, 3.0, 1.0) LIMIT :limit;";
+const QString SQL_BACKFILL_NOTE_SEARCH_KEYS = "INSERT OR IGNORE INTO NoteSearchKey (id) SELECT id FROM Note WHERE id>:from AND id<=:to;";
+const QString SQL_BACKFILL_NOTE_SEARCH = "INSERT OR REPLACE INTO NoteSearch (rowid, id, title, content)"
+                                         " SELECT NoteSearchKey.searchId, Note.id, Note.title, CASE Note.type"
+                                         " WHEN 0 THEN (SELECT text FROM Article WHERE Article.id=Note.id ORDER BY modifDateTime DESC LIMIT 1)"
+                                         " WHEN 1 THEN (SELECT description FROM Media WHERE Media.id=Note.id ORDER BY modifDateTime DESC LIMIT 1)"
+                                         " WHEN 2 THEN (SELECT action FROM Task WHERE Task.id=Note.id ORDER BY modifDateTime DESC LIMIT 1)"
+                                         " END FROM Note JOIN NoteSearchKey ON NoteSearchKey.id=Note.id WHERE Note.id>:from AND Note.id<=:to;";
+const QString SQL_SELECT_BACKFILL_CHUNK_END = "SELECT MAX(id) FROM (SELECT id FROM Note WHERE id>:from ORDER BY id LIMIT :chunk);"; // NULL when no note is left
+const QString SQL_UPDATE_BACKFILL = "UPDATE NoteSearchCursor SET lastId=:to;";
+const QString SQL_END_BACKFILL = "UPDATE NoteSearchCursor SET done=1;";
+const int BACKFILLCHUNK = 500; // Number of notes copied in NoteSearch at each step of the back-fill
+const int WRITEQUEUECAPACITY = 4096; // Number of writes waiting for the PersistenceWorker above which the GUI thread waits for the disk
+const int BACKFILLINTERVAL = 50; // Milliseconds between two steps of the back-fill, to leave the event loop breathe
+
+/* The SQL statements used for the one-time tasks that the migrations of the schema ask for. */
+const QString SQL_SELECT_PENDING_TASK = "SELECT name FROM PendingTask WHERE name=:name;";
+const QString SQL_DELETE_PENDING_TASK = "DELETE FROM PendingTask WHERE name=:name;";
+
+/* The migrations of the schema of the database. The migration i brings the schema from the version i to i+1 ;
+ the version of a database file is stored in PRAGMA user_version. A migration is only allowed to be appended. */
+const QList<QStringList> SCHEMA_MIGRATIONS = QList<QStringList>()
+        // 0 -> 1 : indexes for the couples of a relation or of a note and for the history of a note
+        << (QStringList()
+            << "CREATE INDEX IF NOT EXISTS CoupleRelationIndex ON Couple (relation);"
+            << "CREATE INDEX IF NOT EXISTS CoupleIdDescIndex ON Couple (idDesc);"
+            << "CREATE INDEX IF NOT EXISTS ArticleHistoryIndex ON Article (id, modifDateTime DESC);"
+            << "CREATE INDEX IF NOT EXISTS MediaHistoryIndex ON Media (id, modifDateTime DESC);"
+            << "CREATE INDEX IF NOT EXISTS TaskHistoryIndex ON Task (id, modifDateTime DESC);")
+        // 1 -> 2 : the DateTime strings (local time) become INTEGER milliseconds since the epoch, NULL for no date
+        << (QStringList()
+            << "UPDATE Note SET creationDateTime = CAST(strftime('%s',creationDateTime,'utc') AS INTEGER)*1000 WHERE typeof(creationDateTime)='text';"
+            << "UPDATE Article SET modifDateTime = CAST(strftime('%s',modifDateTime,'utc') AS INTEGER)*1000 WHERE typeof(modifDateTime)='text';"
+            << "UPDATE Media SET modifDateTime = CAST(strftime('%s',modifDateTime,'utc') AS INTEGER)*1000 WHERE typeof(modifDateTime)='text';"
+            << "UPDATE Task SET modifDateTime = CAST(strftime('%s',modifDateTime,'utc') AS INTEGER)*1000 WHERE typeof(modifDateTime)='text';"
+            << "UPDATE Task SET deadLine = CAST(strftime('%s',deadLine,'utc') AS INTEGER)*1000 WHERE typeof(deadLine)='text';")
+        // 2 -> 3 : cursor of the back-fill of NoteSearch, -1 when there's nothing to copy ; the existing notes are copied from the first rowid
+        << (QStringList()
+            << "CREATE TABLE IF NOT EXISTS NoteSearchBackfill (nextRowid INTEGER NOT NULL);"
+            << "DELETE FROM NoteSearchBackfill;"
+            << "INSERT INTO NoteSearchBackfill (nextRowid) VALUES (0);")
+        // 3 -> 4 : the couples of the relation Référence are rebuilt once from the contents of the notes
+        << (QStringList()
+            << "CREATE TABLE IF NOT EXISTS PendingTask (name VARCHAR(50) PRIMARY KEY);"
+            << QString("INSERT OR IGNORE INTO PendingTask (name) VALUES ('%1');").arg(TASK_REBUILD_REFERENCES))
+        // 4 -> 5 : the back-fill of NoteSearch goes through the notes by id instead of rowid ; an unfinished one starts again
+        << (QStringList()
+            << "CREATE TABLE IF NOT EXISTS NoteSearchCursor (done BOOL NOT NULL, lastId VARCHAR(30) NOT NULL);"
+            << "DELETE FROM NoteSearchCursor;"
+            << "INSERT INTO NoteSearchCursor (done, lastId) SELECT nextRowid < 0, '' FROM NoteSearchBackfill;"
+            << "DROP TABLE NoteSearchBackfill;")
+        // 5 -> 6 : the rows of NoteSearch are keyed by a searchId of their own instead of the rowid of the note, which
+        // VACUUM may renumber ; the rows already copied keep their rowid
+        << (QStringList()
+            << "CREATE TABLE IF NOT EXISTS NoteSearchKey (searchId INTEGER PRIMARY KEY, id VARCHAR(30) NOT NULL UNIQUE);"
+            << "INSERT OR IGNORE INTO NoteSearchKey (searchId, id) SELECT rowid, id FROM Note;")
+        // 6 -> 7 : the history indexes of the migration 0 -> 1 duplicate the PRIMARY KEY (id, modifDateTime), which SQLite
+        // already walks backwards for ORDER BY modifDateTime DESC ; they only cost writes and space
+        << (QStringList()
+            << "DROP INDEX IF EXISTS ArticleHistoryIndex;"
+            << "DROP INDEX IF EXISTS MediaHistoryIndex;"
+            << "DROP INDEX IF EXISTS TaskHistoryIndex;");
+
+static bool isSearchWrite(const QString * sql)
+{
+    /*! Returns true if the statement writes in NoteSearch : a full-text search has to wait for it to be committed. */
+    return sql == &SQL_INSERT_NOTE_SEARCH || sql == &SQL_UPDATE_NOTE_SEARCH_TITLE || sql == &SQL_UPDATE_NOTE_SEARCH_CONTENT
+            || sql == &SQL_DELETE_NOTE_SEARCH || sql == &SQL_BACKFILL_NOTE_SEARCH;
+}
+
+static QVariant toEpoch(const QDateTime& dateTime)
+{
+    /*! Returns the value stored in the database for a DateTime : the milliseconds since the epoch, NULL if it's not valid. */
+    if (!dateTime.isValid())
+        return QVariant(QVariant::LongLong);
+    return QVariant(dateTime.toMSecsSinceEpoch());
+}
+
+static QDateTime fromEpoch(const QVariant& value)
+{
+    /*! Returns the DateTime of a value stored in the database. A NULL value gives an invalid DateTime. */
+    if (value.isNull())
+        return QDateTime();
+    return QDateTime::fromMSecsSinceEpoch(value.toLongLong());
+}
+
 SQLiteManager::Handler SQLiteManager::handler=Handler();
 
-SQLiteManager::SQLiteManager()
+SQLiteManager::SQLiteManager() : m_lazyHistory(true), m_batchDepth(0), m_worker(nullptr),
+    m_pendingBatchSearch(false), m_searchTicket(0), m_fullTextSearch(false), m_backfillTimer(nullptr)
+{
+    /*! The canonical constructor of the SQLiteManager. It creates the connection with the database here.
+     * The write-behind mode and the lazy loading of the versions are used unless they are disabled in the settings. */
+    QSettings settings("JAJ & Co", "PluriNotes");
+    m_lazyHistory = settings.value("DataManager/lazyHistory",true).toBool();
+    if (connectionWithDataBase()) {
+        if (settings.value("DataManager/writeBehind",true).toBool())
+            startWriteBehind();
+        m_fullTextSearch = openSearchTable();
+    }
+}
+
+SQLiteManager::~SQLiteManager()
 {
-    /*! The canonical constructor of the SQLiteManager. It creates the connection with the database here.*/
-    connectionWithDataBase();
+    /*! The destructor of the SQLiteManager. It waits for the pending writes and frees the prepared statements.
+     * An unfinished back-fill of NoteSearch goes on at the next start. The timer of the back-fill belongs to the application :
+     * it is already deleted if the application was destroyed first. */
+    delete m_backfillTimer;
+    if (m_worker) {
+        if (m_batchDepth > 0)
+            m_worker->enqueue(m_pendingBatch);
+        delete m_worker; // Drains the queue before stopping
+        m_worker = nullptr;
+    }
+    qDeleteAll(m_statements);
+    m_statements.clear();
 }
 
 
@@ -18,6 +180,51 @@ SQLiteManager &SQLiteManager::getInstance()
     return *handler.instance;
 }
 
+QSqlQuery &SQLiteManager::preparedQuery(const QString * sql) const
+{
+    /*! Returns the prepared statement of one of the SQL constants of this file. The statement is prepared the first time
+     * it is asked for and then kept, so the next calls only have to bind the values and exec.
+     * The cache is indexed by the address of the constant : finding a statement doesn't hash its text. */
+    QHash<const QString*,QSqlQuery*>::const_iterator it = m_statements.constFind(sql);
+    if (it != m_statements.constEnd())
+        return *it.value();
+
+    QSqlQuery * query = new QSqlQuery(plurinotesDatabase);
+    query->setForwardOnly(true);
+    if (!query->prepare(*sql)){
+        QString error = query->lastError().text();
+        delete query;
+        throw NoteException(QString("SQLiteManager::preparedQuery : %1").arg(error).toStdString());
+    }
+    m_statements.insert(sql,query);
+    return *query;
+}
+
+bool SQLiteManager::execWrite(const QString * sql, const Bindings &bindings) const
+{
+    /*! Executes a write. In write-behind mode, the write is enqueued for the PersistenceWorker
+     * (or kept until the end of the current batch) and true is returned ; the ticket of the last write in NoteSearch
+     * is kept for searchNotes(). Otherwise it is executed right away with the prepared statement of the SQL constant. */
+    if (m_worker) {
+        bool searchWrite = m_fullTextSearch && isSearchWrite(sql);
+        if (m_batchDepth > 0) {
+            m_pendingBatch.append(WriteRecord(sql,bindings));
+            m_pendingBatchSearch = m_pendingBatchSearch || searchWrite;
+        }
+        else {
+            quint64 ticket = m_worker->enqueue(WriteRecord(sql,bindings));
+            if (searchWrite)
+                m_searchTicket = ticket;
+        }
+        return true;
+    }
+
+    QSqlQuery& query = preparedQuery(sql);
+    for (Bindings::const_iterator it = bindings.cbegin(); it != bindings.cend(); ++it)
+        query.bindValue(it->first,it->second);
+    return query.exec();
+}
+
 bool SQLiteManager::deleteNote(const Note * noteToDel) const
 {
     /*! Deletes a Note and all its version present in the database. */
@@ -25,18 +232,18 @@ bool SQLiteManager::deleteNote(const Note * noteToDel) const
     if (noteToDel == nullptr)
         throw NoteException("SQLiteManager::deleteNote : noteToDel is nullptr.");
 
-    QSqlQuery query;
+    const QString * sqlVersions;
     switch(noteToDel->getType()){
     case ArticleType:
-        query.prepare("DELETE FROM Article WHERE id=:id;");
+        sqlVersions = &SQL_DELETE_ARTICLE;
         break;
 
     case MediaType:
-        query.prepare("DELETE FROM Media WHERE id=:id;");
+        sqlVersions = &SQL_DELETE_MEDIA;
         break;
 
     case TaskType:
-        query.prepare("DELETE FROM Task WHERE id=:id;");
+        sqlVersions = &SQL_DELETE_TASK;
         break;
 
     case EmptyType:
@@ -47,12 +254,16 @@ bool SQLiteManager::deleteNote(const Note * noteToDel) const
         throw NoteException("SQLiteManager::deleteNote() : No type for the note");
         break;
     }
-    query.bindValue(":id",noteToDel->getId());
-    query.exec();
+    Bindings bindings;
+    bindings << qMakePair(QString(":id"),QVariant(noteToDel->getId()));
+    execWrite(sqlVersions,bindings);
+    // The row of NoteSearch is found by the key of the note : it goes first
+    if (m_fullTextSearch) {
+        execWrite(&SQL_DELETE_NOTE_SEARCH,bindings);
+        execWrite(&SQL_DELETE_NOTE_SEARCH_KEY,bindings);
+    }
     // Erasing in the data base
-    query.prepare("DELETE FROM Note WHERE id=:id;");
-    query.bindValue(":id",noteToDel->getId());
-    return query.exec();
+    return execWrite(&SQL_DELETE_NOTE,bindings);
 }
 
 bool SQLiteManager::saveNote(const Note& n,bool toInsert) const
@@ -60,80 +271,77 @@ bool SQLiteManager::saveNote(const Note& n,bool toInsert) const
     /*! Saves the note in the data base. If its the first saves in the database (ie if toInsert == True),
      * we insert the the Note table ; otherwise we update it.
      * Returns a boolean stating the result. */
-    QSqlQuery query;
+    Bindings bindings;
+    bindings << qMakePair(QString(":id"),QVariant(n.getId()))
+             << qMakePair(QString(":title"),QVariant(n.getTitle()))
+             << qMakePair(QString(":state"),QVariant(QString::number(n.getState())));
+    Bindings searchBindings;
+    searchBindings << qMakePair(QString(":id"),QVariant(n.getId()));
     if (toInsert){
-        query.prepare("INSERT INTO Note (id, title,type,creationDateTime,state)"
-                       "VALUES (:id, :title,:type,:creationDateTime,:state);");
-        query.bindValue(":id",n.getId());
-        query.bindValue(":title",n.getTitle());
-        query.bindValue(":type",QString::number(n.getType()));
-        query.bindValue(":creationDateTime",n.getCreationDateTime().toString(DATEFORMAT));
-        query.bindValue(":state",QString::number(n.getState()));
+        bindings << qMakePair(QString(":type"),QVariant(QString::number(n.getType())))
+                 << qMakePair(QString(":creationDateTime"),toEpoch(n.getCreationDateTime()));
+        bool inserted = execWrite(&SQL_INSERT_NOTE,bindings);
+        if (m_fullTextSearch) {
+            execWrite(&SQL_INSERT_NOTE_SEARCH_KEY,searchBindings);
+            execWrite(&SQL_INSERT_NOTE_SEARCH,searchBindings);
+        }
+        return inserted;
     }
-    else {
-       query.prepare("UPDATE Note SET title=:title,state=:state WHERE id=:id");
-       query.bindValue(":title",n.getTitle());
-       query.bindValue(":state",QString::number(n.getState()));
-       query.bindValue(":id",n.getId());
+    bool updated = execWrite(&SQL_UPDATE_NOTE,bindings);
+    if (m_fullTextSearch) {
+        searchBindings << qMakePair(QString(":title"),QVariant(n.getTitle()));
+        execWrite(&SQL_UPDATE_NOTE_SEARCH_TITLE,searchBindings);
     }
-
-    bool result = query.exec();
-    return result;
+    return updated;
 }
 
 bool SQLiteManager::saveVersion(const Version * vers,const QString& noteID,const NoteType& nt) const
 {
     /*! Saves a Version based on its type by inserting it in the database.*/
-    QSqlQuery query;
 
     if (vers == nullptr)
         throw NoteException("SQLiteManager::saveVersion : Version is nullptr.");
 
+    Bindings bindings;
+    bindings << qMakePair(QString(":id"),QVariant(noteID))
+             << qMakePair(QString(":modifDateTime"),toEpoch(vers->getModifDate()));
+
+    // The new version becomes the content of the note in NoteSearch
+    const QString * sql;
+    QString content;
     switch(nt)
     {
     case ArticleType:
     {
-        const Article *a = dynamic_cast<const Article*>(vers);
+        const Article *a = version_cast<Article>(vers);
 
         /*! Polymorphic method : saves the article in the data base based on the id of the note */
-        query.prepare("INSERT INTO Article (id, modifDateTime, text)"
-                           "VALUES (:id, :modifDateTime, :text);");
-        query.bindValue(":id",noteID);
-        query.bindValue(":modifDateTime",a->getModifDate().toString(DATEFORMAT));
-        query.bindValue(":text",a->getText());
-
-        bool result = query.exec();
-        return result;
+        bindings << qMakePair(QString(":text"),QVariant(a->getText()));
+        sql = &SQL_INSERT_ARTICLE;
+        content = a->getText();
+        break;
     }
     case MediaType:
        {
-        const Media *a = dynamic_cast<const Media*>(vers);
+        const Media *a = version_cast<Media>(vers);
 
-        query.prepare("INSERT INTO Media (id, modifDateTime, description, filename)"
-                           "VALUES(:id, :modifDateTime, :description, :filename);");
-        query.bindValue(":id",noteID);
-        query.bindValue(":modifDateTime",a->getModifDate().toString(DATEFORMAT));
-        query.bindValue(":description",a->getDescription());
-        query.bindValue(":filename",a->getFileName());
-
-        bool result = query.exec();
-        return result;
+        bindings << qMakePair(QString(":description"),QVariant(a->getDescription()))
+                 << qMakePair(QString(":filename"),QVariant(a->getFileName()));
+        sql = &SQL_INSERT_MEDIA;
+        content = a->getDescription();
+        break;
        }
     case TaskType:
        {
-        const Task *a = dynamic_cast<const Task*>(vers);
-
-        query.prepare("INSERT INTO Task (id, modifDateTime, action, status, priority, deadLine)"
-                           "VALUES (:id, :modifDateTime, :action, :status, :priority, :deadLine);");
-        query.bindValue(":id",noteID);
-        query.bindValue(":modifDateTime",a->getModifDate().toString(DATEFORMAT));
-        query.bindValue(":action",a->getAction());
-        query.bindValue(":status",a->getStatus());
-        query.bindValue(":priority",QString::number(a->getPriority()));
-        query.bindValue(":deadLine",a->getDeadLine().toString(DATEFORMAT));
-
-        bool result = query.exec();
-        return result;
+        const Task *a = version_cast<Task>(vers);
+
+        bindings << qMakePair(QString(":action"),QVariant(a->getAction()))
+                 << qMakePair(QString(":status"),QVariant(a->getStatus()))
+                 << qMakePair(QString(":priority"),QVariant(QString::number(a->getPriority())))
+                 << qMakePair(QString(":deadLine"),toEpoch(a->getDeadLine()));
+        sql = &SQL_INSERT_TASK;
+        content = a->getAction();
+        break;
        }
     case EmptyType:
     default:
@@ -141,7 +349,66 @@ bool SQLiteManager::saveVersion(const Version * vers,const QString& noteID,const
         throw NoteException("SQLiteManager::saveVersion : EmptyType or no type");
     }
     }
-    return true;
+    bool saved = execWrite(sql,bindings);
+    if (m_fullTextSearch) {
+        Bindings searchBindings;
+        searchBindings << qMakePair(QString(":id"),QVariant(noteID))
+                       << qMakePair(QString(":content"),QVariant(content));
+        execWrite(&SQL_UPDATE_NOTE_SEARCH_CONTENT,searchBindings);
+    }
+    return saved;
+}
+
+ListVersion SQLiteManager::loadVersionHistory(const QString &noteID, const NoteType &nt, const QDateTime &before) const
+{
+    /*! Loads the versions of a note that are older than 'before', the most recent first.
+     * Used by the Note to fetch its history on demand in lazy mode. */
+    ListVersion versions;
+    const QString * sql;
+    switch(nt)
+    {
+    case ArticleType:
+        sql = &SQL_SELECT_HISTORY_ARTICLE;
+        break;
+    case MediaType:
+        sql = &SQL_SELECT_HISTORY_MEDIA;
+        break;
+    case TaskType:
+        sql = &SQL_SELECT_HISTORY_TASK;
+        break;
+    case EmptyType:
+    default:
+        throw NoteException("SQLiteManager::loadVersionHistory : EmptyType or no type");
+    }
+
+    QSqlQuery& query = preparedQuery(sql);
+    query.bindValue(":id",noteID);
+    query.bindValue(":before",toEpoch(before));
+    if (!query.exec())
+        throw NoteException(QString("SQLiteManager::loadVersionHistory : %1").arg(query.lastError().text()).toStdString());
+
+    NotesManager& manager = NotesManager::getInstance();
+    while (query.next()) {
+        QDateTime modifDateTime = fromEpoch(query.value("modifDateTime"));
+        switch(nt)
+        {
+        case ArticleType:
+            versions.append(manager.newArticle(modifDateTime,query.value("text").toString()));
+            break;
+        case MediaType:
+            versions.append(manager.newMedia(modifDateTime,query.value("description").toString(),query.value("filename").toString()));
+            break;
+        case TaskType:
+            versions.append(manager.newTask(modifDateTime,query.value("action").toString(),
+                                            static_cast<TaskStatus>(query.value("status").toInt()),
+                                            query.value("priority").toUInt(),fromEpoch(query.value("deadLine"))));
+            break;
+        default:
+            break;
+        }
+    }
+    query.finish();
+    return versions;
 }
 
 bool SQLiteManager::saveRelation(const Relation& r,bool toInsert) const
@@ -149,30 +416,20 @@ bool SQLiteManager::saveRelation(const Relation& r,bool toInsert) const
     /*! Saves the relation in the data base. If its the first saves in the database (ie if toInsert == True),
     we insert the Relation table ; otherwise we update it.
     Returns a boolean stating the result. */
-    QSqlQuery query;
-    if (toInsert){
-        query.prepare("INSERT INTO Relation (name, description,isOriented) VALUES (:name, :description, :isOriented);");
-    }
-    else {
-         query.prepare("UPDATE Relation SET description=:description,isOriented=:isOriented WHERE name=:name");
-    }
-    query.bindValue(":description",r.getDescription());
-    query.bindValue(":isOriented",r.isOriented());
-    query.bindValue(":name",r.getName());
-    bool result = query.exec();
-    return result;
+    Bindings bindings;
+    bindings << qMakePair(QString(":description"),QVariant(r.getDescription()))
+             << qMakePair(QString(":isOriented"),QVariant(r.isOriented()))
+             << qMakePair(QString(":name"),QVariant(r.getName()));
+    return execWrite(toInsert ? &SQL_INSERT_RELATION : &SQL_UPDATE_RELATION,bindings);
 }
 
 bool SQLiteManager::deleteCouple(const Couple *coupleToDel, const QString &name) const
 {
-    QSqlQuery query;
-    query.prepare("DELETE FROM Couple WHERE idAsc=:idAsc AND idDesc=:idDesc AND relation=:relation");
-
-    query.bindValue(":idAsc",coupleToDel->getIdAsc());
-    query.bindValue(":idDesc",coupleToDel->getIdDesc());
-    query.bindValue(":relation",name);
-
-    return query.exec();
+    Bindings bindings;
+    bindings << qMakePair(QString(":idAsc"),QVariant(coupleToDel->getIdAsc()))
+             << qMakePair(QString(":idDesc"),QVariant(coupleToDel->getIdDesc()))
+             << qMakePair(QString(":relation"),QVariant(name));
+    return execWrite(&SQL_DELETE_COUPLE,bindings);
 }
 
 bool SQLiteManager::saveCouple(const Couple& c,const QString& name, bool toInsert) const
@@ -180,25 +437,174 @@ bool SQLiteManager::saveCouple(const Couple& c,const QString& name, bool toInser
     /*! Saves the couple in the data base. If its the first saves in the database (ie if toInsert == True),
     we insert the Relation table ; otherwise we update it.
     Returns a boolean stating the result. */
-    QSqlQuery query;
-    if (toInsert){
-        query.prepare("INSERT INTO Couple (idAsc,idDesc,relation,label) VALUES (:idAsc,:idDesc,:relation,:label);");
-        query.bindValue(":idAsc",c.getIdAsc());
-        query.bindValue(":idDesc",c.getIdDesc());
-        query.bindValue(":relation",name);
-        query.bindValue(":label",c.getLabel());
+    Bindings bindings;
+    bindings << qMakePair(QString(":idAsc"),QVariant(c.getIdAsc()))
+             << qMakePair(QString(":idDesc"),QVariant(c.getIdDesc()))
+             << qMakePair(QString(":relation"),QVariant(name))
+             << qMakePair(QString(":label"),QVariant(c.getLabel()));
+    return execWrite(toInsert ? &SQL_INSERT_COUPLE : &SQL_UPDATE_COUPLE,bindings);
+}
 
+QStringList SQLiteManager::searchNotes(const QString &query, int limit) const
+{
+    /*! Returns the IDs of the notes matching the FTS5 query (prefix "mot*", phrase "\"deux mots\"", NEAR(a b, 5)...),
+     * the most relevant first ; a word of the title weighs three times a word of the content.
+     * Returns an empty list if FTS5 isn't available or if the query isn't valid. */
+    QStringList ids;
+    if (!m_fullTextSearch || query.trimmed().isEmpty())
+        return ids;
+    // The writes in NoteSearch waiting in the worker have to be visible ; the other writes don't matter
+    if (m_worker)
+        m_worker->flush(m_searchTicket);
+
+    QSqlQuery& search = preparedQuery(&SQL_SEARCH_NOTES);
+    search.bindValue(":query",query);
+    search.bindValue(":limit",limit);
+    if (!search.exec()) {
+        qWarning() << "SQLiteManager::searchNotes :" << search.lastError().text();
+        return ids;
     }
-    else {
-        query.prepare("UPDATE Couple SET label=:label WHERE idAsc=:idAsc AND idDesc=:idDesc AND relation=:relation;");
-        query.bindValue(":label",c.getLabel());
-        query.bindValue(":idAsc",c.getIdAsc());
-        query.bindValue(":idDesc",c.getIdDesc());
-        query.bindValue(":relation",name);
+    while (search.next())
+        ids.append(search.value(0).toString());
+    search.finish();
+    return ids;
+}
+
+bool SQLiteManager::isTaskPending(const QString &task) const
+{
+    /*! Returns true if the task is in the PendingTask table, where the migrations put the one-time tasks they need.
+     * Read once at startup, so the statement isn't kept. Returns false if the table can't be read. */
+    QSqlQuery query(plurinotesDatabase);
+    query.prepare(SQL_SELECT_PENDING_TASK);
+    query.bindValue(":name",task);
+    if (!query.exec()) {
+        qDebug() << "SQLiteManager::isTaskPending :" << query.lastError().text();
+        return false;
     }
+    return query.next();
+}
 
-    bool result = query.exec();
-    return result;
+void SQLiteManager::setTaskDone(const QString &task) const
+{
+    /*! Removes the task from the PendingTask table. Written in the current batch if there's one. */
+    Bindings bindings;
+    bindings << qMakePair(QString(":name"),QVariant(task));
+    execWrite(&SQL_DELETE_PENDING_TASK,bindings);
+}
+
+void SQLiteManager::beginBatch()
+{
+    /*! Opens a batch of writes. The outermost batch opens a transaction, so all the writes
+     * until the matching commitBatch() are synced to the disk only once.
+     * In write-behind mode, the writes of the batch are kept and enqueued together at the commit, as one batch
+     * that the PersistenceWorker applies entirely or not at all. */
+    if (m_batchDepth == 0 && !m_worker && !plurinotesDatabase.transaction())
+        throw NoteException(QString("SQLiteManager::beginBatch : %1").arg(plurinotesDatabase.lastError().text()).toStdString());
+    m_batchDepth++;
+}
+
+bool SQLiteManager::commitBatch(bool wait)
+{
+    /*! Closes a batch of writes. The transaction is committed when the outermost batch is closed.
+     * Returns false if there's no opened batch or if the commit failed ; the transaction is then rolled back.
+     * In write-behind mode the batch is enqueued and true is returned at once, unless wait is true : the call then
+     * blocks until the PersistenceWorker applied the batch and returns false if it was rolled back. The callers
+     * that change the memory only after a successful commit have to wait. */
+    if (m_batchDepth == 0)
+        return false;
+    m_batchDepth--;
+    if (m_batchDepth > 0)
+        return true;
+    if (m_worker) {
+        quint64 ticket = m_worker->enqueue(m_pendingBatch,wait);
+        if (m_pendingBatchSearch)
+            m_searchTicket = ticket;
+        m_pendingBatch.clear();
+        m_pendingBatchSearch = false;
+        if (!wait)
+            return true;
+        QString error;
+        if (m_worker->flush(ticket,&error))
+            return true;
+        qWarning() << error;
+        return false;
+    }
+    if (plurinotesDatabase.commit())
+        return true;
+    // A failed COMMIT may leave the transaction opened
+    plurinotesDatabase.rollback();
+    return false;
+}
+
+void SQLiteManager::rollbackBatch()
+{
+    /*! Cancels all the writes since the outermost beginBatch(), nested batches included.
+     * The enclosing batches are closed too : their commitBatch() will return false. */
+    if (m_batchDepth == 0)
+        return;
+    m_batchDepth = 0;
+    if (m_worker) {
+        m_pendingBatch.clear();
+        m_pendingBatchSearch = false;
+    }
+    else
+        plurinotesDatabase.rollback();
+}
+
+void SQLiteManager::flush()
+{
+    /*! Blocks until all the writes are in the database. Only the write-behind mode has something to wait for. */
+    if (!m_worker)
+        return;
+    m_worker->flush();
+}
+
+int SQLiteManager::getQueueDepth() const
+{
+    /*! Returns the number of writes waiting for the PersistenceWorker ; 0 if the writes are synchronous. */
+    return m_worker ? m_worker->getQueueDepth() : 0;
+}
+
+int SQLiteManager::getMaxQueueDepth() const
+{
+    /*! Returns the highest number of writes that waited for the PersistenceWorker. */
+    return m_worker ? m_worker->getMaxQueueDepth() : 0;
+}
+
+quint64 SQLiteManager::getNbBlockedWrites() const
+{
+    /*! Returns the number of writes or batches that waited for room in the queue of the PersistenceWorker. */
+    return m_worker ? m_worker->getNbBlockedEnqueues() : 0;
+}
+
+qint64 SQLiteManager::getLastCommitLatency() const
+{
+    /*! Returns the duration in microseconds of the last transaction of the PersistenceWorker. */
+    return m_worker ? m_worker->getLastCommitLatency() : 0;
+}
+
+qint64 SQLiteManager::getAverageCommitLatency() const
+{
+    /*! Returns the average duration in microseconds of the transactions of the PersistenceWorker. */
+    return m_worker ? m_worker->getAverageCommitLatency() : 0;
+}
+
+void SQLiteManager::startWriteBehind()
+{
+    /*! Starts the write-behind mode : from now on the writes are applied by a PersistenceWorker
+     * that has its own connection to the database. The batches it rolls back and that nobody waits for are reported
+     * to the user from the GUI thread, in one notice per transaction. */
+    if (m_worker)
+        return;
+    m_worker = new PersistenceWorker(plurinotesDatabase.databaseName(),WRITEQUEUECAPACITY);
+    QObject::connect(m_worker, &PersistenceWorker::batchesFailed, qApp, [](const QStringList& errors){
+        for (QStringList::const_iterator it = errors.cbegin(); it != errors.cend(); ++it)
+            qWarning() << *it;
+        QMessageBox::warning(0, qApp->tr("Erreur d'enregistrement"),
+                             qApp->tr("%1 lot(s) de modifications n'ont pas pu être enregistrés et ont été annulés dans la base de données.\n\n%2")
+                             .arg(errors.size()).arg(errors.first()));
+    }, Qt::QueuedConnection);
+    m_worker->start();
 }
 
 bool SQLiteManager::connectionWithDataBase()
@@ -209,6 +615,8 @@ bool SQLiteManager::connectionWithDataBase()
     QString localFolder = QCoreApplication::applicationDirPath();
     plurinotesDatabase = QSqlDatabase::addDatabase("QSQLITE");
     plurinotesDatabase.setDatabaseName(localFolder + "/plurinotesDB.db");
+    // The PersistenceWorker may hold the lock of the file while it commits
+    plurinotesDatabase.setConnectOptions("QSQLITE_BUSY_TIMEOUT=5000");
 
     if (!plurinotesDatabase.open()) {
         QMessageBox::critical(0, qApp->tr("Cannot open database"),
@@ -222,12 +630,172 @@ bool SQLiteManager::connectionWithDataBase()
 
     QSqlQuery query;
 
+    // In WAL mode the reads of the GUI thread don't wait for the commits of the PersistenceWorker
+    if (!query.exec("PRAGMA journal_mode=WAL;") || !query.next() || query.value(0).toString().compare("wal",Qt::CaseInsensitive) != 0)
+        qWarning() << "SQLiteManager::connectionWithDataBase : the database can't use WAL : the reads will wait for the writes";
+    query.finish();
+
     if(!query.exec("SELECT * FROM Note")){
         createTemplateDataBase();
     }
+
+    // The database file may have been created by an older version of the application
+    migrateSchema();
+    checkQueryPlans();
     return true;
 }
 
+bool SQLiteManager::openSearchTable()
+{
+    /*! Creates the full-text table NoteSearch if it doesn't exist yet, then starts the back-fill of the notes
+     * from the cursor saved in NoteSearchCursor. Returns false if the SQLite library has no FTS5 : the full-text
+     * search is then disabled. */
+    QSqlQuery query;
+    if (!query.exec("SELECT name FROM sqlite_master WHERE type='table' AND name='NoteSearch';"))
+        return false;
+    bool exists = query.next();
+    query.finish();
+    if (!exists) {
+        if (!query.exec(SQL_CREATE_NOTE_SEARCH)) {
+            qWarning() << "SQLiteManager::openSearchTable : full-text search disabled :" << query.lastError().text();
+            return false;
+        }
+        // Every note has to be copied in the new table
+        query.exec("DELETE FROM NoteSearchCursor;");
+        query.exec("INSERT INTO NoteSearchCursor (done, lastId) VALUES (0, '');");
+    }
+
+    if (query.exec("SELECT done, lastId FROM NoteSearchCursor;") && query.next() && !query.value(0).toBool()) {
+        m_backfillLastId = query.value(1).toString();
+        // The timer belongs to the application and stops with it ; the static SQLiteManager may be destroyed later
+        m_backfillTimer = new QTimer(qApp);
+        m_backfillTimer->setInterval(BACKFILLINTERVAL);
+        QObject::connect(m_backfillTimer, &QTimer::timeout, [this]{ backfillSearchChunk(); });
+        QObject::connect(qApp, &QCoreApplication::aboutToQuit, m_backfillTimer, &QTimer::stop);
+        m_backfillTimer->start();
+    }
+    query.finish();
+    return true;
+}
+
+void SQLiteManager::backfillSearchChunk()
+{
+    /*! Copies the next chunk of notes, in the order of their id, in NoteSearch with their latest version, and moves the cursor
+     * to the last id copied. Paging on the id keeps the cursor right if notes are deleted or created meanwhile ;
+     * the notes created meanwhile are written in NoteSearch by saveNote() anyway.
+     * The copy and the cursor are written in the same batch through execWrite, so they go to the PersistenceWorker
+     * in write-behind mode. The back-fill stops when no note is left after the cursor. */
+    QSqlQuery& chunkEnd = preparedQuery(&SQL_SELECT_BACKFILL_CHUNK_END);
+    chunkEnd.bindValue(":from",m_backfillLastId);
+    chunkEnd.bindValue(":chunk",BACKFILLCHUNK);
+    QVariant to;
+    if (chunkEnd.exec() && chunkEnd.next())
+        to = chunkEnd.value(0);
+    chunkEnd.finish();
+
+    if (to.isNull()) {
+        m_backfillTimer->stop();
+        m_backfillTimer->deleteLater();
+        m_backfillTimer = nullptr;
+        execWrite(&SQL_END_BACKFILL,Bindings());
+        return;
+    }
+
+    Bindings bindings;
+    bindings << qMakePair(QString(":from"),QVariant(m_backfillLastId))
+             << qMakePair(QString(":to"),to);
+    Bindings cursorBindings;
+    cursorBindings << qMakePair(QString(":to"),to);
+    beginBatch();
+    try {
+        execWrite(&SQL_BACKFILL_NOTE_SEARCH_KEYS,bindings);
+        execWrite(&SQL_BACKFILL_NOTE_SEARCH,bindings);
+        execWrite(&SQL_UPDATE_BACKFILL,cursorBindings);
+    }
+    catch (...) {
+        rollbackBatch();
+        throw;
+    }
+    commitBatch();
+    m_backfillLastId = to.toString();
+}
+
+bool SQLiteManager::migrateSchema()
+{
+    /*! Upgrades the schema of the database in place, from its PRAGMA user_version to the last version.
+     * Each migration is applied in its own transaction with the update of user_version.
+     * Returns true if at least one migration was applied. */
+    QSqlQuery query;
+    if (!query.exec("PRAGMA user_version;") || !query.next())
+        throw NoteException(QString("SQLiteManager::migrateSchema : %1").arg(query.lastError().text()).toStdString());
+    int version = query.value(0).toInt();
+    query.finish();
+
+    bool migrated = false;
+    for (; version < SCHEMA_MIGRATIONS.size(); version++) {
+        if (!plurinotesDatabase.transaction())
+            throw NoteException(QString("SQLiteManager::migrateSchema : migration %1 can't start : %2").arg(version).arg(plurinotesDatabase.lastError().text()).toStdString());
+        const QStringList& statements = SCHEMA_MIGRATIONS.at(version);
+        for (QStringList::const_iterator it = statements.cbegin(); it != statements.cend(); ++it) {
+            if (!query.exec(*it)) {
+                QString error = query.lastError().text();
+                plurinotesDatabase.rollback();
+                throw NoteException(QString("SQLiteManager::migrateSchema : migration %1 failed : %2").arg(version).arg(error).toStdString());
+            }
+        }
+        // PRAGMA doesn't accept bound values ; the migration counts as applied only if user_version is committed with it
+        if (!query.exec(QString("PRAGMA user_version = %1;").arg(version + 1))) {
+            QString error = query.lastError().text();
+            plurinotesDatabase.rollback();
+            throw NoteException(QString("SQLiteManager::migrateSchema : migration %1 failed : %2").arg(version).arg(error).toStdString());
+        }
+        if (!plurinotesDatabase.commit()) {
+            QString error = plurinotesDatabase.lastError().text();
+            plurinotesDatabase.rollback();
+            throw NoteException(QString("SQLiteManager::migrateSchema : migration %1 can't be committed : %2").arg(version).arg(error).toStdString());
+        }
+        qDebug() << "SQLiteManager::migrateSchema : database upgraded to version" << version + 1;
+        migrated = true;
+    }
+    return migrated;
+}
+
+bool SQLiteManager::checkQueryPlans() const
+{
+    /*! Checks with EXPLAIN QUERY PLAN that the hot reads and writes find their rows through an index : the couples of a
+     * relation, the history of a note and the writes on a couple. A step that scans a table or sorts in a temporary
+     * B-tree means an index is missing from the database file ; it is reported with a warning.
+     * Returns true if every statement uses its index. */
+    QStringList statements;
+    statements << SQL_SELECT_COUPLES_OF_RELATION
+               << SQL_SELECT_HISTORY_ARTICLE << SQL_SELECT_HISTORY_MEDIA << SQL_SELECT_HISTORY_TASK
+               << SQL_UPDATE_COUPLE << SQL_DELETE_COUPLE;
+
+    bool indexed = true;
+    QRegularExpression placeholder(":\\w+"); // The named placeholders are bound to NULL
+    for (QStringList::const_iterator it = statements.cbegin(); it != statements.cend(); ++it) {
+        QSqlQuery query(plurinotesDatabase);
+        query.prepare("EXPLAIN QUERY PLAN " + *it);
+        QRegularExpressionMatchIterator itP = placeholder.globalMatch(*it);
+        while (itP.hasNext())
+            query.bindValue(itP.next().captured(),QVariant());
+        if (!query.exec()) {
+            qWarning() << "SQLiteManager::checkQueryPlans : EXPLAIN QUERY PLAN failed for" << *it << ":" << query.lastError().text();
+            indexed = false;
+            continue;
+        }
+        // The last column of EXPLAIN QUERY PLAN is the description of the step
+        while (query.next()) {
+            QString step = query.value(query.record().count() - 1).toString();
+            if (step.startsWith("SCAN") || step.startsWith("USE TEMP B-TREE")) {
+                qWarning() << "SQLiteManager::checkQueryPlans : no index used by" << *it << ":" << step;
+                indexed = false;
+            }
+        }
+    }
+    return indexed;
+}
+
 
 bool SQLiteManager::createTemplateDataBase()
 {
@@ -331,12 +899,16 @@ bool SQLiteManager::createTemplateDataBase()
 void SQLiteManager::loadNotesAndVersions() const
 {
     /*! Load all the Notes from the SQLite database ie. query it and creates Note objects
-    and Version objects for each object note (see SQL tables) */
+    and Version objects for each object note (see SQL tables).
+    Each table is read only once with a forward-only cursor : the Note table first, then
+    each version table ordered by id and modifDateTime. */
 
     NotesManager& noteManager = NotesManager::getInstance();
 
     // First Query to get the notes
-    QSqlQuery queryAllNote("SELECT * FROM Note;");
+    QSqlQuery queryAllNote;
+    queryAllNote.setForwardOnly(true);
+    queryAllNote.exec(SQL_SELECT_NOTES);
 
     /* Those 'fooField' short uint are used to locate data in the QslQuery
      It avoids using hard coded int to get the data from the query cursor */
@@ -352,91 +924,114 @@ void SQLiteManager::loadNotesAndVersions() const
     QDateTime creationDateTime;
     NoteState state;
 
-
     while (queryAllNote.next()) { // For each note in the dataBase
         // We catch the informations
         id = queryAllNote.value(idField).toString();
         title = queryAllNote.value(titleField).toString();
         type = static_cast<NoteType>(queryAllNote.value(typeField).toInt());
-        creationDateTime = queryAllNote.value(creationDateTimeField).toDateTime();
+        creationDateTime = fromEpoch(queryAllNote.value(creationDateTimeField));
         state = static_cast<NoteState>(queryAllNote.value(stateField).toInt());
 
-        // We create a new Note object
-        Note * newNote = noteManager.createNote(id,title,type,creationDateTime,state,false);
-
-        // Then we have to create all the versions of this Note, in order to do this :
-
-        // We create a map of parameters to be passed to create a Version object via Note::createVersion()
-        Dico dico;
-
-        short unsigned int modifDateTimeField;
-
-        // Getting all the versions of the note based on the type
-        switch (newNote->getType()) {
-            case ArticleType: {
-                QSqlQuery queryArticle("SELECT * FROM Article WHERE ID ='"+id+"' ORDER BY  modifDateTime ASC;");
-                modifDateTimeField = queryArticle.record().indexOf("modifDateTime");
-
-                short unsigned int textField = queryArticle.record().indexOf("text");
-
-                while (queryArticle.next()) {
-                    dico["modifDateTime"] = queryArticle.value(modifDateTimeField);
-                    dico["text"] = queryArticle.value(textField);
-                    newNote->createVersion(dico,true); //fromPersistentData == true
-                    dico.clear();
-                }
-            }
-                break;
-            case MediaType: {
-                QSqlQuery queryMedia("SELECT * FROM Media WHERE ID ='"+id+"' ORDER BY  modifDateTime ASC;");
-                modifDateTimeField = queryMedia.record().indexOf("modifDateTime");
-
-                short unsigned int descriptionField = queryMedia.record().indexOf("description");
-                short unsigned int filenameField = queryMedia.record().indexOf("filename");
-
-                while (queryMedia.next()) {
-                    dico["modifDateTime"] = queryMedia.value(modifDateTimeField);
-                    dico["description"] = queryMedia.value(descriptionField);
-                    dico["filename"] = queryMedia.value(filenameField);
-                    newNote->createVersion(dico,true); //fromPersistentData == true
-                    dico.clear();
-                }
-                break;
-            }
-            case TaskType: {
-                QSqlQuery queryTask("SELECT * FROM Task WHERE ID ='"+id+"' ORDER BY  modifDateTime ASC;");
-                modifDateTimeField = queryTask.record().indexOf("modifDateTime");
-
-                short unsigned int actionField = queryTask.record().indexOf("action");
-                short unsigned int statusField = queryTask.record().indexOf("status");
-                short unsigned int priorityField = queryTask.record().indexOf("priority");
-                short unsigned int deadLineField = queryTask.record().indexOf("deadLine");
+        if (type != ArticleType && type != MediaType && type != TaskType)
+            throw NoteException("SQLiteManager::loadNotesAndVersions : bad type for a note");
 
+        // We create a new Note object, its versions are added by the next queries
+        Note * newNote = noteManager.createNote(id,title,type,creationDateTime,state,false);
+        // In lazy mode only the last version is loaded, the older ones will be fetched by Note::begin()
+        newNote->setHistoryLoaded(!m_lazyHistory);
+    }
 
-                while (queryTask.next()) {
-                    dico["modifDateTime"] = queryTask.value(modifDateTimeField);
-                    dico["action"] = queryTask.value(actionField);
-                    dico["status"] = queryTask.value(statusField);
-                    dico["priority"] = queryTask.value(priorityField);
-                    dico["deadLine"] = queryTask.value(deadLineField);
+    // Then we stream each version table once, from the oldest to the most recent version of each note
+    // (or only the most recent version of each note in lazy mode)
+    loadArticles();
+    loadMedia();
+    loadTasks();
 
+    /* At this moment we have created the notes and all their versions ;*/
+}
 
-                    newNote->createVersion(dico,true); //fromPersistentData == true
-                    dico.clear();
-                }
-                break;
-            }
-            case EmptyType:
-                throw NoteException("SQLiteManager::loadNotesAndVersions : Empty Type");
-                break;
+Note *SQLiteManager::findLoadedNote(const QString &id, NoteType type, Note *current) const
+{
+    /*! Returns the note of the version row that is read. The rows are sorted by id,
+     * so the lookup in the NotesManager is only done when the id changes.
+     * nullptr is returned if the note doesn't exist or isn't of the right type. */
+    if (current && current->getId() == id)
+        return current;
+
+    Note * note = NotesManager::getInstance().findNote(id);
+    if (note && note->getType() != type)
+        return nullptr;
+    return note;
+}
 
-            default:
-                throw NoteException("SQLiteManager::loadNotesAndVersions default case : empty");
-                break;
+void SQLiteManager::loadArticles() const
+{
+    /*! Loads all the rows of the Article table in a single pass and adds them to their note. */
+    QSqlQuery queryArticle;
+    queryArticle.setForwardOnly(true);
+    queryArticle.exec(m_lazyHistory ? SQL_SELECT_HEAD_ARTICLES : SQL_SELECT_ALL_ARTICLES);
+
+    short unsigned int idField = queryArticle.record().indexOf("id");
+    short unsigned int modifDateTimeField = queryArticle.record().indexOf("modifDateTime");
+    short unsigned int textField = queryArticle.record().indexOf("text");
+
+    NotesManager& manager = NotesManager::getInstance();
+    Note * current = nullptr;
+    while (queryArticle.next()) {
+        current = findLoadedNote(queryArticle.value(idField).toString(),ArticleType,current);
+        if (current)
+            current->addVersion(manager.newArticle(fromEpoch(queryArticle.value(modifDateTimeField)),
+                                                  queryArticle.value(textField).toString()));
+    }
+}
 
-        }// End of switch on Note::m_type
+void SQLiteManager::loadMedia() const
+{
+    /*! Loads all the rows of the Media table in a single pass and adds them to their note. */
+    QSqlQuery queryMedia;
+    queryMedia.setForwardOnly(true);
+    queryMedia.exec(m_lazyHistory ? SQL_SELECT_HEAD_MEDIA : SQL_SELECT_ALL_MEDIA);
+
+    short unsigned int idField = queryMedia.record().indexOf("id");
+    short unsigned int modifDateTimeField = queryMedia.record().indexOf("modifDateTime");
+    short unsigned int descriptionField = queryMedia.record().indexOf("description");
+    short unsigned int filenameField = queryMedia.record().indexOf("filename");
+
+    NotesManager& manager = NotesManager::getInstance();
+    Note * current = nullptr;
+    while (queryMedia.next()) {
+        current = findLoadedNote(queryMedia.value(idField).toString(),MediaType,current);
+        if (current)
+            current->addVersion(manager.newMedia(fromEpoch(queryMedia.value(modifDateTimeField)),
+                                                 queryMedia.value(descriptionField).toString(),
+                                                 queryMedia.value(filenameField).toString()));
+    }
+}
 
-        /* At this moment we have created the note and all its versions ;*/
+void SQLiteManager::loadTasks() const
+{
+    /*! Loads all the rows of the Task table in a single pass and adds them to their note. */
+    QSqlQuery queryTask;
+    queryTask.setForwardOnly(true);
+    queryTask.exec(m_lazyHistory ? SQL_SELECT_HEAD_TASKS : SQL_SELECT_ALL_TASKS);
+
+    short unsigned int idField = queryTask.record().indexOf("id");
+    short unsigned int modifDateTimeField = queryTask.record().indexOf("modifDateTime");
+    short unsigned int actionField = queryTask.record().indexOf("action");
+    short unsigned int statusField = queryTask.record().indexOf("status");
+    short unsigned int priorityField = queryTask.record().indexOf("priority");
+    short unsigned int deadLineField = queryTask.record().indexOf("deadLine");
+
+    NotesManager& manager = NotesManager::getInstance();
+    Note * current = nullptr;
+    while (queryTask.next()) {
+        current = findLoadedNote(queryTask.value(idField).toString(),TaskType,current);
+        if (current)
+            current->addVersion(manager.newTask(fromEpoch(queryTask.value(modifDateTimeField)),
+                                                queryTask.value(actionField).toString(),
+                                                static_cast<TaskStatus>(queryTask.value(statusField).toInt()),
+                                                queryTask.value(priorityField).toUInt(),
+                                                fromEpoch(queryTask.value(deadLineField))));
     }
 }
 
@@ -445,7 +1040,7 @@ void SQLiteManager::loadRelationsAndCouples() const
     /*! Load all the Relations from the SQLite database ie. query it and creates Relation objects
     and Couple objects for each object Relation (see SQL tables) */
     NotesManager& noteManager = NotesManager::getInstance();
-    QSqlQuery queryAllRelations("SELECT * FROM Relation;");
+    QSqlQuery queryAllRelations(SQL_SELECT_RELATIONS);
 
     /* Those 'fooField' short uint are used to locate data in the QslQuery
      It avoids using hard coded int to get the data from the query cursor */
@@ -468,7 +1063,10 @@ void SQLiteManager::loadRelationsAndCouples() const
         Note * noteAsc = nullptr;
         Note * noteDesc = nullptr;
 
-        QSqlQuery queryAllCouples("SELECT * FROM Couple WHERE relation ='"+name+"';");
+        // The couples of the relation are found with the index on Couple (relation)
+        QSqlQuery& queryAllCouples = preparedQuery(&SQL_SELECT_COUPLES_OF_RELATION);
+        queryAllCouples.bindValue(":relation",name);
+        queryAllCouples.exec();
 
         short unsigned int idAscField = queryAllCouples.record().indexOf("idAsc");
         short unsigned int idDescField = queryAllCouples.record().indexOf("idDesc");
@@ -483,6 +1081,7 @@ void SQLiteManager::loadRelationsAndCouples() const
             noteDesc = noteManager.findNote(idDesc);
             newRelation->createCouple(noteAsc,noteDesc,label,false); //toInsert == false
         }
+        queryAllCouples.finish();
     }
     if(!noteManager.findRelation("Référence"))
         noteManager.createRelation("Référence","Le document A référence le document B",true,true); //isOriented == saveInDB == true
@@ -9,10 +9,14 @@
 #include <QDebug>
 #include <string>
 #include <iostream>
+#include <QTimer>
+#include <QPointer>
 
 #include "note.h"
 #include "relation.h"
+#include "persistenceworker.h"
 
+const QString TASK_REBUILD_REFERENCES = "rebuildReferences"; /*!< Pending task : the relation Référence has to be rebuilt from the contents of the notes. */
 
 /*! \class AbstractDataManager
  *  \brief The abstract class that interfaces with the data.
@@ -30,9 +34,18 @@ public:
     virtual bool deleteNote(const Note * noteToDel) const = 0; /*!< The virtual method that deletes a Note from the persistent data. */
     virtual bool saveNote(const Note& n,bool toInsert=false) const = 0; /*!< The virtual method that saves a Note in the persistent data. */
     virtual bool saveVersion(const Version *vers, const QString &noteID, const NoteType &nt) const = 0; /*!< The virtual method that saves a Version of a Note in the persistent data. */
+    virtual ListVersion loadVersionHistory(const QString &noteID, const NoteType &nt, const QDateTime &before) const = 0; /*!< The virtual method that loads the versions of a Note older than a date, the most recent first. */
     virtual bool saveRelation(const Relation &r, bool toInsert) const = 0; /*!< The virtual method that saves a Relation in the persistent data. */
     virtual bool deleteCouple(const Couple * coupleToDel,const QString& name) const = 0; /*!< The virtual method that deletes a Couple from the persistent data. */
     virtual bool saveCouple(const Couple& c,const QString& name, bool toInsert) const = 0; /*!< The virtual method that saves a Couple in the persistent data. */
+    virtual QStringList searchNotes(const QString& query, int limit = 50) const = 0; /*!< The virtual method that returns the IDs of the notes matching a full-text query, the most relevant first. */
+    virtual bool isTaskPending(const QString& task) const = 0; /*!< The virtual method that returns true if a one-time task was asked for by the persistent data and isn't done yet. */
+    virtual void setTaskDone(const QString& task) const = 0; /*!< The virtual method that records in the persistent data that a one-time task is done. */
+
+    virtual void beginBatch() = 0; /*!< The virtual method that opens a batch : the writes until commitBatch() are grouped. Batches can be nested. */
+    virtual bool commitBatch(bool wait=false) = 0; /*!< The virtual method that closes a batch and makes its writes persistent. If wait is true, it returns once they are, false if they were cancelled. */
+    virtual void rollbackBatch() = 0; /*!< The virtual method that cancels all the writes of the current batch. */
+    virtual void flush() = 0; /*!< The virtual method that blocks until all the writes are persistent. */
 };
 
 /*! \class SQLiteManager
@@ -46,11 +59,21 @@ class SQLiteManager : public AbstractDataManager {
      */
     friend class NotesManager;
     SQLiteManager();
-    ~SQLiteManager() {}
+    ~SQLiteManager();
     void operator=(const SQLiteManager&) {} /*!< Private redéfinition of the = operator for the Singleton */
     SQLiteManager(const SQLiteManager&) {} /*!< Private redéfinition of the copy constructor for the Singleton. */
 
     QSqlDatabase plurinotesDatabase; /*!< The object corresponding to the database used. */
+    bool m_lazyHistory; /*!< If true, only the most recent version of each note is loaded at startup. */
+    int m_batchDepth; /*!< Number of nested batches currently opened. The transaction is opened by the outermost one. */
+    mutable QHash<const QString*,QSqlQuery*> m_statements; /*!< The prepared statements kept alive, indexed by the address of their SQL constant. */
+    PersistenceWorker * m_worker; /*!< The thread applying the writes in write-behind mode ; nullptr if the writes are synchronous. */
+    mutable WriteBatch m_pendingBatch; /*!< In write-behind mode, the writes of the current batch, enqueued together at the commit. */
+    mutable bool m_pendingBatchSearch; /*!< True if m_pendingBatch writes in NoteSearch. */
+    mutable quint64 m_searchTicket; /*!< Ticket in the PersistenceWorker of the last batch writing in NoteSearch ; the full-text search waits for it only. */
+    bool m_fullTextSearch; /*!< True if the SQLite library has FTS5 and the NoteSearch table is available. */
+    QString m_backfillLastId; /*!< ID of the last note copied by the back-fill of NoteSearch ; the next chunk starts after it. */
+    QPointer<QTimer> m_backfillTimer; /*!< Drives the back-fill of NoteSearch, one chunk at a time, from the event loop. Owned by the application ; null when the back-fill is done. */
 
     /*! \struct SQLiteManager::Handler
      *  \brief The class that handles the unique instance of SQLiteManager for the Singleton.
@@ -63,11 +86,20 @@ class SQLiteManager : public AbstractDataManager {
     };
     static Handler handler; /*!< The handler of the unique instance of the manager */
 
-    const QString DATEFORMAT = QString("yyyy-MM-dd hh:mm:ss"); /*!< The DateTime format used to store DateTime strings in the database */
-
     virtual void loadNotesAndVersions() const override;
     virtual void loadRelationsAndCouples() const override;
+    void loadArticles() const; /*!< Streams the Article table and adds the versions to the notes. */
+    void loadMedia() const; /*!< Streams the Media table and adds the versions to the notes. */
+    void loadTasks() const; /*!< Streams the Task table and adds the versions to the notes. */
+    Note * findLoadedNote(const QString& id, NoteType type, Note * current) const; /*!< Returns the note owning a version row while streaming a version table. */
+    QSqlQuery& preparedQuery(const QString * sql) const; /*!< Returns the cached prepared statement of a SQL constant. */
+    bool execWrite(const QString * sql, const Bindings& bindings) const; /*!< Executes or enqueues the write of a SQL constant. */
+    void startWriteBehind(); /*!< Starts the PersistenceWorker. */
     bool createTemplateDataBase();
+    bool migrateSchema(); /*!< Upgrades the schema of the database to the last version. */
+    bool checkQueryPlans() const; /*!< Warns about the hot statements that don't use an index. */
+    bool openSearchTable(); /*!< Creates the NoteSearch table if needed and starts its back-fill. */
+    void backfillSearchChunk(); /*!< Copies the next chunk of notes in NoteSearch. */
     bool connectionWithDataBase();
     static SQLiteManager& getInstance(); /*!< Gives the unique instance of the SQLiteManager */
 
@@ -75,9 +107,25 @@ public:
     virtual bool deleteNote(const Note * noteToDel) const override;
     virtual bool saveNote(const Note& n,bool toInsert=false) const override;
     virtual bool saveVersion(const Version *vers, const QString &noteID, const NoteType &nt) const override;
+    virtual ListVersion loadVersionHistory(const QString &noteID, const NoteType &nt, const QDateTime &before) const override;
     virtual bool saveRelation(const Relation &r, bool toInsert=false) const override;
     virtual bool deleteCouple(const Couple * coupleToDel,const QString& name) const override;
     virtual bool saveCouple(const Couple& c,const QString& name, bool toInsert=false) const override;
+    virtual QStringList searchNotes(const QString& query, int limit = 50) const override;
+    virtual bool isTaskPending(const QString& task) const override;
+    virtual void setTaskDone(const QString& task) const override;
+
+    virtual void beginBatch() override;
+    virtual bool commitBatch(bool wait=false) override;
+    virtual void rollbackBatch() override;
+    virtual void flush() override;
+
+    // Counters of the write-behind mode
+    int getQueueDepth() const;
+    int getMaxQueueDepth() const;
+    quint64 getNbBlockedWrites() const;
+    qint64 getLastCommitLatency() const;
+    qint64 getAverageCommitLatency() const;
 };
 
 #endif // DATAMANAGER_H
@@ -1,14 +1,100 @@
 #include "delegue.h"
 
-Delegue::Delegue(QWidget *parent)
+const int LAYOUTCACHESIZE = 2000; // Number of cell layouts kept in the cache
+const int CELLMARGIN = 4; // Margin around the title and the text, in pixels
+const int MAXTITLELINES = 2; // The title is elided after this number of lines
+const int MAXTEXTLINES = 6; // The text is elided after this number of lines
+const QSize DEFAULTCELLSIZE(100,100); // Size of an empty cell, and of the rows not measured yet
+
+Delegue::Delegue(QWidget *parent) : m_layouts(LAYOUTCACHESIZE)
 {
     /*! Do nothing */
     Q_UNUSED(parent);
 }
 
+static QString elideLines(QString text, const QFont &font, int width, int maxLines)
+{
+    /*! Returns the text wrapped in lines of width pixels, cut after maxLines lines : the last line then ends with an ellipsis. */
+    text.replace(QLatin1Char('\n'), QChar::LineSeparator);
+    QTextLayout layout(text, font);
+    QTextOption option;
+    option.setWrapMode(QTextOption::WrapAtWordBoundaryOrAnywhere);
+    layout.setTextOption(option);
+
+    int nbLines = 0;
+    int lastLineStart = 0;
+    bool cut = false;
+    layout.beginLayout();
+    for (QTextLine line = layout.createLine(); line.isValid(); line = layout.createLine()) {
+        line.setLineWidth(width);
+        if (nbLines == maxLines - 1)
+            lastLineStart = line.textStart();
+        if (++nbLines > maxLines) {
+            cut = true;
+            break;
+        }
+    }
+    layout.endLayout();
+    if (!cut)
+        return text;
+
+    QString lastLine = text.mid(lastLineStart);
+    lastLine.replace(QChar::LineSeparator, QLatin1Char(' '));
+    return text.left(lastLineStart) + QFontMetrics(font).elidedText(lastLine, Qt::ElideRight, width);
+}
+
+const CellLayout *Delegue::layoutOf(const Dico &dataMap, int column, const QFont &font, int width) const
+{
+    /*! Returns the layout of the cell, from the cache if the note and the width haven't changed since it was computed. */
+    CellKey key = {dataMap["handle"].toUInt(), dataMap["lastUpdate"].toDateTime().toMSecsSinceEpoch(), width};
+    CellLayout * cell = m_layouts.object(key);
+    if (cell != nullptr)
+        return cell;
+
+    //Get the text to draw in terms of the type of note
+    QString textToDraw;
+    switch(column)
+    {
+        case ArticleType:
+            textToDraw = dataMap["text"].toString();
+            break;
+        case MediaType:
+            textToDraw = dataMap["description"].toString();
+            break;
+        case TaskType:
+            textToDraw = dataMap["action"].toString();
+            break;
+    }
+
+    int textWidth = qMax(1, width - 2*CELLMARGIN);
+    cell = new CellLayout;
+
+    //Align the title in the center
+    QTextOption optTitle(Qt::AlignHCenter);
+    optTitle.setWrapMode(QTextOption::WrapAtWordBoundaryOrAnywhere);
+    cell->title.setTextFormat(Qt::PlainText);
+    cell->title.setTextOption(optTitle);
+    cell->title.setTextWidth(textWidth);
+    cell->title.setText(elideLines(dataMap["title"].toString(), font, textWidth, MAXTITLELINES));
+    cell->title.prepare(QTransform(), font);
+
+    //Align the main text to the left
+    QTextOption optMainText(Qt::AlignLeft);
+    optMainText.setWrapMode(QTextOption::WrapAtWordBoundaryOrAnywhere);
+    cell->text.setTextFormat(Qt::PlainText);
+    cell->text.setTextOption(optMainText);
+    cell->text.setTextWidth(textWidth);
+    cell->text.setText(elideLines(textToDraw, font, textWidth, MAXTEXTLINES));
+    cell->text.prepare(QTransform(), font);
+
+    cell->size = QSize(width, 3*CELLMARGIN + qCeil(cell->title.size().height()) + qCeil(cell->text.size().height()));
+    m_layouts.insert(key, cell);
+    return cell;
+}
+
 void Delegue::paint(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index) const
 {
-    /*! Get the data of a note and defines the components to draw it */
+    /*! Get the data of a note and draws the layout of its cell */
     Dico dataMap = index.model()->data(index).value<Dico>();
 
     painter->setBrush(Qt::white);
@@ -21,62 +107,34 @@ void Delegue::paint(QPainter *painter, const QStyleOptionViewItem &option, const
     if (option.state & QStyle::State_Selected)
         painter->fillRect(option.rect, option.palette.highlight());
 
+    // Empty cell, below the last note of the column
+    if (dataMap.isEmpty())
+        return;
+
     //Prepare the data to be painted in black
     QPen pen;
 
     pen.setBrush(Qt::black);
 
     painter->setPen(pen);
+    painter->setFont(option.font);
 
-    //Align the title in the center
-    QTextOption optTitle;
-    optTitle.setAlignment(Qt::AlignHCenter);
-
-    //Align the main text to the left
-    QTextOption optMainText;
-    optMainText.setAlignment(Qt::AlignLeft);
-
-    QString titleToDraw= dataMap["title"].toString();;
-    QString textToDraw;
-
-    //Necessary to set text below the title
-    QRect rectText = option.rect;
-    rectText.setY(rectText.y()+30+(titleToDraw.size()/20)*30);
-
+    const CellLayout * cell = layoutOf(dataMap, index.column(), option.font, option.rect.width());
 
-
-
-
-    //Get the text to draw in terms of the type of note
-    switch(index.column())
-    {
-        case ArticleType:
-        {
-            textToDraw = dataMap["text"].toString();
-
-            break;
-        }
-        case MediaType:
-        {
-            textToDraw = dataMap["description"].toString();
-            break;
-        }
-        case TaskType:
-        {
-            textToDraw = dataMap["action"].toString();
-            break;
-        }
-    }
-
-    //Draw the text
-    painter->drawText(option.rect, titleToDraw, optTitle);
-    painter->drawText(rectText, textToDraw, optMainText);//
+    //Draw the text below the title
+    QPointF position = option.rect.topLeft() + QPointF(CELLMARGIN, CELLMARGIN);
+    painter->drawStaticText(position, cell->title);
+    position.ry() += qCeil(cell->title.size().height()) + CELLMARGIN;
+    painter->drawStaticText(position, cell->text);
 }
 
 QSize Delegue::sizeHint(const QStyleOptionViewItem &option, const QModelIndex &index) const
 {
-    /*! Arbritrary size a case by default*/
-    Q_UNUSED(option);
-    Q_UNUSED(index);
-    return QSize(100, 100);
+    /*! Size measured from the layout of the cell ; a default size for an empty cell */
+    if (!index.isValid())
+        return DEFAULTCELLSIZE;
+    Dico dataMap = index.model()->data(index).value<Dico>();
+    if (dataMap.isEmpty() || option.rect.width() <= 0)
+        return DEFAULTCELLSIZE;
+    return layoutOf(dataMap, index.column(), option.font, option.rect.width())->size;
 }
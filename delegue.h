@@ -2,13 +2,36 @@
 #define DELEGUE_H
 
  #include <QtWidgets>
+#include <QCache>
+#include <QStaticText>
 #include "note.h"
 
+/*! \struct CellKey
+ *  \brief Identifies the layout of a cell : the note, its head version and the width of the column.
+ */
+struct CellKey {
+    NoteHandle handle; /*!< Handle of the note shown in the cell */
+    qint64 version; /*!< Date of modification of the head version of the note, in ms since epoch */
+    int width; /*!< Width of the cell */
+    bool operator==(const CellKey& other) const { return handle == other.handle && version == other.version && width == other.width;} /*!< Equality, used by the cache */
+};
+
+inline uint qHash(const CellKey& key, uint seed = 0) { return qHash(qMakePair(key.handle,key.version),seed) ^ uint(key.width);} /*!< Hash of a CellKey, used by the cache */
+
+/*! \struct CellLayout
+ *  \brief The title and the text of a cell, laid out and elided once, with the size they need.
+ */
+struct CellLayout {
+    QStaticText title; /*!< The title, centered */
+    QStaticText text; /*!< The text, description or action */
+    QSize size; /*!< The size needed by the cell */
+};
+
 /**
  * \class Delegue
  * \brief [Inherited from QStyledItemDelegate]  Class that defines how the cases are drawn in the table
  *
- *
+ * The layout of each cell is computed once and kept in a cache, until the note gets a new version or the column is resized.
  */
 class Delegue : public QStyledItemDelegate
 {
@@ -17,6 +40,11 @@ public:
 
     void paint(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index) const;
     QSize sizeHint(const QStyleOptionViewItem &option, const QModelIndex &index) const;
+
+private:
+    mutable QCache<CellKey,CellLayout> m_layouts; /*!< Layouts of the cells. Mutable since they are computed when the cells are painted. */
+
+    const CellLayout * layoutOf(const Dico& dataMap, int column, const QFont& font, int width) const;
 };
 
 #endif // DELEGUE_H
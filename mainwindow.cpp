@@ -1,6 +1,8 @@
 #include "mainwindow.h"
+#include "thumbnailservice.h"
 
 const QString DATEFORMAT = "yyyy-MM-dd hh:mm:ss";
+const int SEARCHDELAY = 250; // Milliseconds without typing before the search is run
 
 MainWindow::MainWindow(QWidget *parent) :
     QMainWindow(parent)
@@ -16,6 +18,30 @@ MainWindow::MainWindow(QWidget *parent) :
     m_gridview = new QTableView;
     m_listArchive = new QListWidget;
     m_leftPart = new QVBoxLayout;
+
+    // Search on the content of the notes ; the index is built after the first paint, on a worker thread
+    m_searchBar = new QLineEdit;
+    m_searchBar->setPlaceholderText("Indexation des notes...");
+    m_searchBar->setEnabled(false);
+    m_searchResults = new QListWidget;
+    m_searchResults->hide();
+    m_leftPart->addWidget(m_searchBar);
+    m_leftPart->addWidget(m_searchResults);
+
+    m_searchIndex = new SearchIndex(this);
+    connect(m_searchIndex, &SearchIndex::ready, this, [this]{
+        m_searchBar->setPlaceholderText("Rechercher");
+        m_searchBar->setEnabled(true);
+    });
+    // The search is run once the user stops typing, not at each keystroke
+    m_searchTimer = new QTimer(this);
+    m_searchTimer->setSingleShot(true);
+    m_searchTimer->setInterval(SEARCHDELAY);
+    connect(m_searchBar, SIGNAL(textChanged(QString)), m_searchTimer, SLOT(start()));
+    connect(m_searchTimer, &QTimer::timeout, this, [this]{ searchNotes(m_searchBar->text()); });
+    connect(m_searchResults, SIGNAL(itemClicked(QListWidgetItem*)), this, SLOT(searchResultClicked(QListWidgetItem*)));
+    QTimer::singleShot(0, m_searchIndex, SLOT(build()));
+
     m_leftPart->addWidget(m_gridview);
 
     QLabel *noteArchive = new QLabel("Notes archivées: ");
@@ -28,7 +54,11 @@ MainWindow::MainWindow(QWidget *parent) :
     connect(m_listArchive, SIGNAL(activated(QModelIndex)), this, SLOT(listArchiveClicked(QModelIndex)));
 
 
+    // The archive list is sorted by ID and follows the changes of state of the notes
+    m_listArchive->setSortingEnabled(true);
     loadArchive();
+    connect(&m, &NotesManager::noteStateChanged, this, &MainWindow::noteStateChanged);
+    connect(&m, &NotesManager::noteTitleChanged, this, &MainWindow::noteTitleChanged);
 
     // Classical top bar menu
     QMenu *noteMenu = menuBar()->addMenu(tr("&Note"));
@@ -74,6 +104,23 @@ MainWindow::MainWindow(QWidget *parent) :
         m_relations->show();
     });
 
+    relationMenu->addSeparator();
+
+    QAction *actionRebuildReferences = relationMenu->addAction("Reconstruire les références");
+    connect(actionRebuildReferences,&QAction::triggered,this,[=]{
+        // An exception must not leave the slot
+        try {
+            int nbChanges = NotesManager::getInstance().rebuildReferences();
+            if (nbChanges == 0)
+                QMessageBox::information(this, "Références", "Les références sont déjà à jour.");
+            else
+                QMessageBox::information(this, "Références", QString("Références reconstruites : %1 couple(s) modifié(s).").arg(nbChanges));
+        }
+        catch (const NoteException& e) {
+            QMessageBox::warning(this, "Références", QString("Les références n'ont pas pu être reconstruites.\n\n%1").arg(e.what()));
+        }
+    });
+
     QAction *actionUndo = editMenu->addAction("Annuler");
     actionUndo->setShortcut(QKeySequence(Qt::CTRL + Qt::Key_Z));
     connect(actionUndo, SIGNAL(triggered(bool)), this, SLOT(undo()));
@@ -119,7 +166,10 @@ MainWindow::MainWindow(QWidget *parent) :
     Delegue *delegate = new Delegue(this);
     m_gridview->setItemDelegate(delegate);
 
-    m_gridview->resizeRowsToContents();      // necessary to use size defined in the delegate
+    // The rows have the default size of the delegate ; only the visible ones are resized to their content
+    m_gridview->verticalHeader()->setDefaultSectionSize(delegate->sizeHint(QStyleOptionViewItem(), QModelIndex()).height());
+    connect(m_gridview->verticalScrollBar(), SIGNAL(valueChanged(int)), this, SLOT(resizeVisibleRows()));
+    connect(m_model, SIGNAL(rowsInserted(QModelIndex,int,int)), this, SLOT(resizeVisibleRows()));
     m_gridview->resizeColumnsToContents(); // necessary to use size defined in the delegate
 
     resize(500,500);
@@ -149,11 +199,11 @@ MainWindow::MainWindow(QWidget *parent) :
 
     m_relations = new RelationView();
     m_relations->show();
-    connect(m_relations, SIGNAL(selectIdSignal(QString)), this, SLOT(selectionChangedInRightWid(QString)));
+    connect(m_relations, SIGNAL(selectNoteSignal(NoteHandle)), this, SLOT(selectionChangedInRightWid(NoteHandle)));
 
     m_relationstree = new RelationTreeView(this,m_interface->getID());
     m_relationstree->show();
-    connect(m_relationstree, SIGNAL(selectIdSignal(QString)), this, SLOT(selectionChangedInRightWid(QString)));
+    connect(m_relationstree, SIGNAL(selectNoteSignal(NoteHandle)), this, SLOT(selectionChangedInRightWid(NoteHandle)));
 
     // Showing up the main interface
     m_leftPartWid = new QWidget(this);
@@ -218,8 +268,7 @@ void MainWindow::openDialog(NoteType type)
     /*! Open the dialog to create a new note */
     NewNoteDialog dia(type);
     dia.exec();                                        // we could return a value
-    emit m_model->layoutChanged();        // Necessary to update the model and the view
-    m_gridview->resizeRowsToContents(); // Necessary to have cases at the right size
+    resizeVisibleRows(); // Necessary to have cases at the right size
 }
 
 void MainWindow::versionDisplayer()
@@ -255,9 +304,6 @@ void MainWindow::updateNote()
         m_model->setData(ref, v);
         selectionChangedInTable(m_selectionModel->currentIndex(), QModelIndex());
         m_interface->disableSubmitButton();
-        m_relations->addCoupleRelation(m_relations->getCurrentRelation());
-        loadArchive();
-        emit m_model->layoutChanged();
     }
 
 }
@@ -270,8 +316,6 @@ void MainWindow::deleteNote()
         m.deleteNote(m_interface->getID());
 
     selectionChangedInTable(m_selectionModel->currentIndex(), QModelIndex()); // Update the note at the new position
-    loadArchive(); // Update the archive liste
-    m_model->layoutChanged();
 
 }
 
@@ -284,8 +328,6 @@ void MainWindow::archiveNote()
     if(m_interface->getID() != "" && (m.findNote(m_interface->getID())->getState() == active))
     {
         m_undoStack.push(new ArchiveCommand(m_interface->getID()));
-        m_listArchive->addItem(m_interface->getID() + " - " + m_interface->getTitle());
-        emit m_model->layoutChanged();
         selectionChangedInTable(m_selectionModel->currentIndex(), QModelIndex()); // Update the note at the new position
     }
 }
@@ -296,9 +338,7 @@ void MainWindow::restoreNote()
     /*! Restore a note from archive */
 
     m_undoStack.push(new RestoreCommand(m_interface->getID()));
-    loadArchive();
-    emit m_model->layoutChanged();
-    m_gridview->resizeRowsToContents();
+    resizeVisibleRows();
 
 }
 
@@ -309,9 +349,8 @@ void MainWindow::showBin()
     Trash dia;
     dia.exec();
 
-    //Reload the tableview
-    emit m_model->layoutChanged();
-    m_gridview->resizeRowsToContents();
+    //The model follows the restored notes; only the heights of the visible rows are updated
+    resizeVisibleRows();
 
 
 }
@@ -329,8 +368,6 @@ void MainWindow::undo()
     /*! Undo the last command pushed on the stack */
 
     m_undoStack.undo();
-    loadArchive();
-    m_model->layoutChanged();
 }
 
 void MainWindow::redo()
@@ -338,8 +375,6 @@ void MainWindow::redo()
     /*! Redo te last command undone */
 
     m_undoStack.redo();
-    loadArchive();
-    m_model->layoutChanged();
 }
 
 void MainWindow::createCouple()
@@ -348,8 +383,6 @@ void MainWindow::createCouple()
 
     NewCoupleDialog cp;
     cp.exec();
-    m_relations->addCoupleRelation(m_relations->getRelation());
-    m_relationstree->setId(m_interface->getID());
 }
 
 void MainWindow::createRelation()
@@ -373,9 +406,7 @@ void MainWindow::selectionChangedInArchive(int row)
     if(m_listArchive->currentItem() == nullptr)
         return;
 
-    QString id = m_listArchive->currentItem()->text().split(" - ").at(0);
-
-    Note *n = m.findNote(id);
+    Note *n = m.getNote(m_listArchive->currentItem()->data(Qt::UserRole).toUInt());
     if(n == nullptr)
         return;
 
@@ -427,7 +458,7 @@ void MainWindow::selectionChangedInTable(const QModelIndex &current, const QMode
 }
 
 
-void MainWindow::selectionChangedInRightWid(const QString &id)
+void MainWindow::selectionChangedInRightWid(NoteHandle handle)
 {
     /*! Displays the selected note in the central interface
      * Called when user selected a note in the relation view or relation tree view */
@@ -435,7 +466,9 @@ void MainWindow::selectionChangedInRightWid(const QString &id)
     m_selectionModel->clearSelection();
     m_listArchive->clearSelection();
 
-    Note *n = m.findNote(id);
+    Note *n = m.getNote(handle);
+    if(n == nullptr)
+        return;
     Dico dataMap = getDataMapFromNote(n);
     chooseStrategy(n->getType(), dataMap);
 
@@ -545,6 +578,11 @@ void MainWindow::closeEvent(QCloseEvent *event)
         }
     }
 
+    // The pending writes have to be in the database before leaving
+    m.getDataManager().flush();
+    // The decoding threads and the media players have to stop while the application still runs
+    ThumbnailService::freeService();
+
     writeSettings();
     event->accept();
 }
@@ -554,14 +592,99 @@ void MainWindow::loadArchive()
     /*! Clear the archive list and displays all archived elements */
 
     m_listArchive->clear();
-    for(NotesManager::const_iteratorNote it = m.cbeginNote();it!=m.cendNote();it++)
+    m_archiveItems.clear();
+    for(NotesManager::const_iteratorNote it = m.cbeginNote(archive);it!=m.cendNote(archive);it++)
     {
-        if((*it)->getState() == archive)
-            m_listArchive->addItem(new QListWidgetItem((*it)->getId() + " - " + (*it)->getTitle()));
+        addArchiveItem(*it);
     }
 
 }
 
+void MainWindow::addArchiveItem(const Note *note)
+{
+    /*! Adds the item of an archived note in the archive list */
+
+    QListWidgetItem *item = new QListWidgetItem(note->getId() + " - " + note->getTitle());
+    item->setData(Qt::UserRole, note->getHandle());
+    m_listArchive->addItem(item);
+    m_archiveItems.insert(note, item);
+}
+
+void MainWindow::noteStateChanged(Note *note, NoteState oldState)
+{
+    /*! Only the item of the note is added to or removed from the archive list */
+
+    if(oldState == archive)
+        delete m_archiveItems.take(note); // Deleting the item removes it from the list
+    if(note->getState() == archive)
+        addArchiveItem(note);
+}
+
+void MainWindow::searchNotes(const QString &query)
+{
+    /*! Shows the notes matching the query, the most relevant first. The notes in the bin aren't shown.
+     * The queries using the FTS5 syntax (phrase, prefix or NEAR) are sent to the data manager ; the others to the in-memory index. */
+
+    m_searchResults->clear();
+    bool fullTextQuery = query.contains('"') || query.contains('*') || query.contains("NEAR");
+    QList<const Note*> notes;
+    if(fullTextQuery)
+    {
+        // The data manager only knows the IDs : they are resolved once here
+        const QStringList ids = m.getDataManager().searchNotes(query);
+        for(QStringList::const_iterator it = ids.cbegin(); it != ids.cend(); it++)
+            notes.append(m.findNote(*it));
+    }
+    else
+    {
+        const QList<NoteHandle> handles = m_searchIndex->search(query);
+        for(QList<NoteHandle>::const_iterator it = handles.cbegin(); it != handles.cend(); it++)
+            notes.append(m.getNote(*it));
+    }
+    for(QList<const Note*>::const_iterator it = notes.cbegin(); it != notes.cend(); it++)
+    {
+        const Note *n = *it;
+        if(n != nullptr && n->getState() != dustbin)
+        {
+            QListWidgetItem *item = new QListWidgetItem(n->getId() + " - " + n->getTitle());
+            item->setData(Qt::UserRole, n->getHandle());
+            m_searchResults->addItem(item);
+        }
+    }
+    m_searchResults->setVisible(!query.trimmed().isEmpty());
+}
+
+void MainWindow::searchResultClicked(QListWidgetItem *item)
+{
+    /*! Displays the note selected in the search results */
+
+    selectionChangedInRightWid(item->data(Qt::UserRole).toUInt());
+}
+
+void MainWindow::resizeVisibleRows()
+{
+    /*! Resizes the rows visible in the grid to their content. The other rows keep the default height :
+     * they are resized when they are scrolled to, so the cost doesn't depend on the number of notes. */
+
+    int firstRow = m_gridview->rowAt(0);
+    if(firstRow < 0)
+        return;
+    int lastRow = m_gridview->rowAt(m_gridview->viewport()->height() - 1);
+    if(lastRow < 0)
+        lastRow = m_model->rowCount() - 1;
+    for(int row = firstRow; row <= lastRow; row++)
+        m_gridview->resizeRowToContents(row);
+}
+
+void MainWindow::noteTitleChanged(Note *note)
+{
+    /*! Updates the item of the note in the archive list */
+
+    QListWidgetItem *item = m_archiveItems.value(note, nullptr);
+    if(item != nullptr)
+        item->setText(note->getId() + " - " + note->getTitle());
+}
+
 void MainWindow::chooseStrategy(const NoteType &type, const Dico &dataMap)
 {
     /*! Defines which widget must be displayed in terms of the type received
@@ -618,14 +741,14 @@ Dico MainWindow::getDataMapFromNote(Note *n)
      {
         case ArticleType:
         {
-           Article *a = dynamic_cast<Article*>(n->getLastversion());
+           Article *a = version_cast<Article>(n->getLastversion());
            dataMap["text"] = a->getText();
            break;
 
         }
         case MediaType:
         {
-            Media *med = dynamic_cast<Media*>(n->getLastversion());
+            Media *med = version_cast<Media>(n->getLastversion());
             dataMap["description"] = med->getDescription();
             dataMap["filename"] = med->getFileName();
 
@@ -633,7 +756,7 @@ Dico MainWindow::getDataMapFromNote(Note *n)
         }
         case TaskType:
         {
-            Task *t = dynamic_cast<Task*>(n->getLastversion());
+            Task *t = version_cast<Task>(n->getLastversion());
             dataMap["priority"] = t->getPriority();
             dataMap["action"] = t->getAction();
             dataMap["deadLine"] = t->getDeadLine();
@@ -13,6 +13,7 @@
 #include "newrelationdialog.h"
 #include "relationtreeview.h"
 #include "relationview.h"
+#include "searchindex.h"
 
 /*! \class MainWindow
  * \brief [Inherited from QMainWindow] Class that manages all the widgets of the project
@@ -48,12 +49,18 @@ private slots:
 
     void selectionChangedInTable(const QModelIndex &current, const QModelIndex &previous);
     void selectionChangedInArchive(int row);
-    void selectionChangedInRightWid(const QString &id);
+    void selectionChangedInRightWid(NoteHandle handle);
+    void noteStateChanged(Note *note, NoteState oldState);
+    void noteTitleChanged(Note *note);
+    void searchNotes(const QString &query);
+    void searchResultClicked(QListWidgetItem *item);
+    void resizeVisibleRows();
 
 private:
     void writeSettings();
     void readSettings();
     void loadArchive();
+    void addArchiveItem(const Note *note);
     void chooseStrategy(const NoteType &type, const Dico &dataMap);
     Dico getDataMapFromNote(Note *n);
 
@@ -68,6 +75,11 @@ private:
     QTableView *m_gridview; /*!< Table on the left used to show active notes */
     QItemSelectionModel *m_selectionModel; /*!< Used to manage the selected case of the table*/
     QListWidget *m_listArchive; /*!< List of the archived notes on the left part */
+    QLineEdit *m_searchBar; /*!< Field to search the notes on their content */
+    QListWidget *m_searchResults; /*!< Notes found by the search, the most relevant first */
+    QTimer *m_searchTimer; /*!< Single-shot timer restarted at each keystroke in m_searchBar : the search runs when it times out */
+    SearchIndex *m_searchIndex; /*!< Index used by the search */
+    QHash<const Note*,QListWidgetItem*> m_archiveItems; /*!< Items of m_listArchive indexed by their note */
     QVBoxLayout *m_leftPart; /*!< Layout used to aggregate m_listArchive and m_gridview */
     QWidget *m_leftPartWid; /*!< Widget used to adapt the m_leftPart layout*/
     QWidget *m_rightPartWid;  /*!< Widget used to adapt the m_rightLayout layout*/
@@ -9,10 +9,9 @@ NewCoupleDialog::NewCoupleDialog()
 
     // We had the Notes' id to the combo in order for the user to choose which couple to create
     QStringList listIDNotes;
-    for(NotesManager::const_iteratorNote itN = manager.cbeginNote(); itN != manager.cendNote();itN++){
-        if ((*itN)->isEditable()){ // We just propose the Notes that are editable
-            listIDNotes.append((*itN)->getId());
-        }
+    // We just propose the Notes that are editable, i.e. the active ones
+    for(NotesManager::const_iteratorNote itN = manager.cbeginNote(active); itN != manager.cendNote(active);itN++){
+        listIDNotes.append((*itN)->getId());
     }
     ui.comboNote1->addItems(listIDNotes);
     ui.comboNote2->addItems(listIDNotes);
@@ -1,20 +1,27 @@
 #include "note.h"
 #include "notesmanager.h"
 #include "datamanager.h"
+#include <cstring>
 
 
 using namespace std;
 
-const QString REGEXPTOFINDID = "\\\\ref{\\w+}";
+const QString REFPREFIX = "\\ref{"; // A reference to a note is written "\ref{id}"
 
 void Note::setTitle(QString title) {
+    NotesManager& manager = NotesManager::getInstance();
     m_title = title;
-    NotesManager::getInstance().getDataManager().saveNote(*this);
+    manager.getDataManager().saveNote(*this);
+    emit manager.noteTitleChanged(this);
 }
 
 void Note::setState(NoteState s) {
+    NotesManager& manager = NotesManager::getInstance();
+    NoteState oldState = m_state;
     m_state = s;
-    NotesManager::getInstance().getDataManager().saveNote(*this);
+    manager.getDataManager().saveNote(*this);
+    if (oldState != s)
+        manager.stateChanged(this,oldState);
 }
 
 void Note::createVersion(Dico& dico, bool fromPersistentData) {
@@ -36,7 +43,7 @@ void Note::createVersion(Dico& dico, bool fromPersistentData) {
         {
             QString text = dico["text"].toString();
 
-            Article * newArticle = new Article(modifDateTime, text);
+            Article * newArticle = NotesManager::getInstance().newArticle(modifDateTime, text);
 
             m_versions.push_front(newArticle);
             break;
@@ -46,7 +53,7 @@ void Note::createVersion(Dico& dico, bool fromPersistentData) {
             QString description = dico["description"].toString();
             QString filename = dico["filename"].toString();
 
-            Media * newMedia = new Media(modifDateTime, description,filename);
+            Media * newMedia = NotesManager::getInstance().newMedia(modifDateTime, description,filename);
 
             m_versions.push_front(newMedia);
             break;
@@ -58,7 +65,7 @@ void Note::createVersion(Dico& dico, bool fromPersistentData) {
             uint priority =  dico["priority"].toInt();
             QDateTime deadLine = dico["deadLine"].toDateTime(); // toDateTime
 
-            Task * newTask = new Task(modifDateTime, action,status,priority,deadLine);
+            Task * newTask = NotesManager::getInstance().newTask(modifDateTime, action,status,priority,deadLine);
 
             m_versions.push_front(newTask);
             break;
@@ -72,13 +79,55 @@ void Note::createVersion(Dico& dico, bool fromPersistentData) {
     }
     if (!fromPersistentData) {// If the version was created by the app,
         Version *newVersionJustCreated = getLastversion();
+        // The references of the new version are derived from the ones of the previous version
+        if (m_versions.size() > 1) {
+            EditedSpan span;
+            if (dico.contains("editStart"))
+                span = EditedSpan(dico["editStart"].toInt(),dico["editEnd"].toInt(),dico["editDelta"].toInt());
+            newVersionJustCreated->deriveReferences(m_versions.at(1),span);
+        }
         // We save it in the via the datamanager
         NotesManager::getInstance().getDataManager().saveVersion(newVersionJustCreated,getId(),getType());
         // We update the couple of the relation Référence
         updateReferences();
+        emit NotesManager::getInstance().noteVersionAdded(this);
     }
 }
 
+Note::~Note()
+{
+    /*! The versions belong to the note : they are given back to the pools of the NotesManager they were created from. */
+    if (m_versions.isEmpty())
+        return;
+    NotesManager& manager = NotesManager::getInstance();
+    for (ListVersion::const_iterator it = m_versions.cbegin(); it != m_versions.cend(); ++it)
+        manager.releaseVersion(*it);
+    m_versions.clear();
+}
+
+void Note::addVersion(Version *v)
+{
+    /*! Adds a version built by the data manager on top of the list, without going through a Dico.
+     * The versions have to be added from the oldest to the most recent. */
+    if (v == nullptr)
+        throw NoteException("Note::addVersion : version is nullptr.");
+    if (v->getType() != getType())
+        throw NoteException("Note::addVersion : type of the version doesn't match the note.");
+    m_versions.push_front(v);
+}
+
+void Note::loadHistory() const
+{
+    /*! Appends the versions that are older than the ones in memory, fetched from the data manager.
+     * It is only done once, the first time the versions are walked through. */
+    if (m_historyLoaded)
+        return;
+    m_historyLoaded = true;
+    if (m_versions.isEmpty())
+        return;
+    m_versions += NotesManager::getInstance().getDataManager().loadVersionHistory(getId(),getType(),m_versions.back()->getModifDate());
+}
+
 Version *Note::getLastversion()
 {
     /*! Returns the last version of the note */
@@ -103,22 +152,50 @@ void Note::debugPrintVersions() const
     }
 }
 
-QSet<QString> getIDsFromText(const QString& stringToFindIdWithin)
+static inline bool isIdCharacter(ushort c)
 {
-    /*! Returns the list of ID (eg "foo") contained in the string in this way : "\id{foo}" */
-    QRegularExpression re(REGEXPTOFINDID); // Our regex (see the header)
-    // We use an iterator that contains all the id catched
-    QRegularExpressionMatchIterator it = re.globalMatch(stringToFindIdWithin);
-
-    QSet<QString> IDset; // the set of ID to return
-
-    while (it.hasNext()) {
-        QRegularExpressionMatch match = it.next();
-        QString idMatched = match.captured().remove("\\ref{").remove("}");
+    /*! Returns true if the character can be part of an ID in a reference : [A-Za-z0-9_], as \w in a regular expression. */
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
 
-        IDset.insert(idMatched);
+QVector<QStringRef> findReferences(const QStringRef &text)
+{
+    /*! Returns views on the IDs (eg "foo") referenced in the text in this way : "\ref{foo}".
+     * The text is read in a single pass : the backslashes are found with QStringRef::indexOf, which is vectorized,
+     * and the rest of the reference is checked in place. The views point in the string viewed by text : nothing is copied,
+     * so they are valid as long as this string is. */
+    QVector<QStringRef> ids;
+    const QString * string = text.string();
+    const QChar * data = text.unicode();
+    const int offset = text.position();
+    const int size = text.size();
+    const int prefixSize = REFPREFIX.size();
+
+    int from = text.indexOf(QLatin1Char('\\'));
+    while (from >= 0) {
+        int start = from + prefixSize;
+        int next = from + 1;
+        if (start < size && QStringRef(string,offset + from,prefixSize) == REFPREFIX) {
+            int end = start;
+            while (end < size && isIdCharacter(data[end].unicode()))
+                end++;
+            if (end > start && end < size && data[end] == QLatin1Char('}')) {
+                ids.append(QStringRef(string,offset + start,end - start));
+                next = end + 1;
+            }
+        }
+        from = text.indexOf(QLatin1Char('\\'),next);
     }
+    return ids;
+}
 
+QSet<QString> getIDsFromText(const QString& stringToFindIdWithin)
+{
+    /*! Returns the list of ID (eg "foo") contained in the string in this way : "\ref{foo}" */
+    QSet<QString> IDset; // the set of ID to return
+    const QVector<QStringRef> ids = findReferences(QStringRef(&stringToFindIdWithin));
+    for (QVector<QStringRef>::const_iterator it = ids.cbegin(); it != ids.cend(); ++it)
+        IDset.insert(it->toString());
     return IDset;
 }
 
@@ -158,27 +235,38 @@ void Note::updateReferences() const
     Couple * currentCouple = nullptr;
     Note * noteToHandle = nullptr;
 
-    // We create the new couples
-    for(QSet<QString>::iterator it = idToReference.begin(); it != idToReference.end(); it++){
-        noteToHandle = manager.findNote(*it);
-        if (noteToHandle){
-            referenceRelation->createCouple(this,noteToHandle);
-        }
-    }
-
     // In order to ask to delete notes if there are no more referenced
     QSet<QString> setNoteToAskDelete;
 
-    // We delete the old couples
-    for(QSet<QString>::iterator it = idToDereference.begin(); it != idToDereference.end(); it++){
-        noteToHandle = manager.findNote(*it);
-        currentCouple = referenceRelation->getCouple(this,noteToHandle);
-        if(noteToHandle->getState() == archive && (manager.getNotesThatReference(noteToHandle)).size()== 1){
-            // If so, then the last one couple is the one to delete and we can ask to delete the note
-            setNoteToAskDelete << noteToHandle->getId();
+    // The couples are created and deleted in one batch
+    AbstractDataManager& dataManager = manager.getDataManager();
+    dataManager.beginBatch();
+    try {
+        // We create the new couples
+        for(QSet<QString>::iterator it = idToReference.begin(); it != idToReference.end(); it++){
+            noteToHandle = manager.findNote(*it);
+            // The notes of the bin can't be referenced : their couples would outlive them
+            if (noteToHandle && noteToHandle->getState() != dustbin){
+                referenceRelation->createCouple(this,noteToHandle);
+            }
+        }
+
+        // We delete the old couples
+        for(QSet<QString>::iterator it = idToDereference.begin(); it != idToDereference.end(); it++){
+            noteToHandle = manager.findNote(*it);
+            currentCouple = referenceRelation->getCouple(this,noteToHandle);
+            if(noteToHandle->getState() == archive && (manager.getNotesThatReference(noteToHandle)).size()== 1){
+                // If so, then the last one couple is the one to delete and we can ask to delete the note
+                setNoteToAskDelete << noteToHandle->getId();
+            }
+            referenceRelation->deleteCouple(currentCouple);
         }
-        referenceRelation->deleteCouple(currentCouple);
     }
+    catch (...) {
+        dataManager.rollbackBatch();
+        throw;
+    }
+    dataManager.commitBatch();
     qDebug() << setNoteToAskDelete.size();
     for(QSet<QString>::iterator it = setNoteToAskDelete.begin(); it != setNoteToAskDelete.end(); it++) {
         QMessageBox::StandardButton askDeleteNote;
@@ -194,17 +282,118 @@ void Note::updateReferences() const
 
 
 
+QSet<QString> Version::parseData(QSet<QString> idSet) const
+{
+    /*! Returns idSet with the IDs of the notes referenced by the version. */
+    const ReferenceCounts& counts = getReferences();
+    for (ReferenceCounts::const_iterator it = counts.cbegin(); it != counts.cend(); ++it)
+        idSet.insert(it.key());
+    return idSet;
+}
+
+const ReferenceCounts &Version::getReferences() const
+{
+    /*! Returns the number of references to each ID in the version. The text entries are parsed the first time only. */
+    if (!m_referencesKnown) {
+        ReferenceCounts counts;
+        countReferences(counts);
+        setReferences(counts);
+    }
+    return m_references;
+}
+
+void Version::addReferences(ReferenceCounts &counts, const QStringRef &text, int delta)
+{
+    /*! Adds delta to the count of each ID referenced in the text. The IDs whose count falls to 0 are removed. */
+    const QVector<QStringRef> ids = findReferences(text);
+    for (QVector<QStringRef>::const_iterator it = ids.cbegin(); it != ids.cend(); ++it) {
+        ReferenceCounts::iterator itC = counts.insert(it->toString(),counts.value(it->toString()) + delta);
+        if (itC.value() <= 0)
+            counts.erase(itC);
+    }
+}
+
+static bool isReferenceCharacter(QChar c)
+{
+    /*! Returns true if the character can be inside a reference, after its backslash : "ref{", the ID or "}". */
+    return isIdCharacter(c.unicode()) || c == QLatin1Char('{');
+}
+
+void Version::diffReferences(ReferenceCounts &counts, const QString &oldText, const QString &newText, const EditedSpan &span)
+{
+    /*! Updates counts, the references of oldText, to the references of newText.
+     * The common prefix and suffix of the two texts are given by span, the part changed in the editor : the cost then depends
+     * on the size of the edit only. When the span is unknown (eg a version restored) or does not fit the two texts,
+     * the prefix and the suffix are found by comparing the texts, which stays linear in their size.
+     * The edited part is widened to the references it cuts, then the references of this part are removed from the old text
+     * and added from the new one. */
+    const int oldSize = oldText.size();
+    const int newSize = newText.size();
+    const QChar * oldData = oldText.constData();
+    const QChar * newData = newText.constData();
+
+    int prefix = 0;
+    int suffix = 0;
+    const int spanEnd = qMin(span.end,newSize); // The editor counts a last paragraph separator that is not in the text
+    if (span.isKnown() && oldSize + span.delta == newSize && span.start <= spanEnd && span.start <= spanEnd - span.delta) {
+        prefix = span.start;
+        suffix = newSize - spanEnd;
+    }
+    else {
+        // Common prefix and suffix, compared by blocks
+        const int maxCommon = qMin(oldSize,newSize);
+        const int block = 256;
+        while (prefix + block <= maxCommon && memcmp(oldData + prefix,newData + prefix,block * sizeof(QChar)) == 0)
+            prefix += block;
+        while (prefix < maxCommon && oldData[prefix] == newData[prefix])
+            prefix++;
+        const int maxSuffix = maxCommon - prefix;
+        while (suffix + block <= maxSuffix && memcmp(oldData + oldSize - suffix - block,newData + newSize - suffix - block,block * sizeof(QChar)) == 0)
+            suffix += block;
+        while (suffix < maxSuffix && oldData[oldSize - suffix - 1] == newData[newSize - suffix - 1])
+            suffix++;
+    }
+    if (prefix == oldSize && prefix == newSize)
+        return; // Same text
+
+    // A reference cut by the edit starts with the last backslash before it and ends with the first "}" after it
+    int start = prefix;
+    while (start > 0 && isReferenceCharacter(oldData[start - 1]))
+        start--;
+    if (start > 0 && oldData[start - 1] == QLatin1Char('\\'))
+        start--;
+    int extra = 0;
+    while (extra < suffix && isReferenceCharacter(oldData[oldSize - suffix + extra]))
+        extra++;
+    if (extra < suffix && oldData[oldSize - suffix + extra] == QLatin1Char('}'))
+        extra++;
+
+    addReferences(counts,oldText.midRef(start,oldSize - suffix + extra - start),-1);
+    addReferences(counts,newText.midRef(start,newSize - suffix + extra - start),1);
+}
+
 void Article::debugPrintInfo() const
 {
     /*! Polymorphic method : display the info stored in the article */
     qDebug() << " - Text : " << getText();
 }
 
-QSet<QString> Article::parseData(QSet<QString> idSet) const
+void Article::countReferences(ReferenceCounts &counts) const
 {
-    /*! Polymorphic method : returns the list of the IDs contained in the text of the article. */
-    idSet += getIDsFromText(getText());
-    return idSet;
+    /*! Polymorphic method : counts the references contained in the text of the article. */
+    addReferences(counts,QStringRef(&m_text),1);
+}
+
+void Article::deriveReferences(const Version *previous, const EditedSpan &span) const
+{
+    /*! The references of the new text are derived from the ones of the previous text : only the part that was edited
+     * is parsed again. When the editor gave the edited span, the cost depends on the size of the edit, not on the size of the article. */
+    const Article * previousArticle = version_cast<Article>(previous);
+    if (previousArticle == nullptr)
+        return;
+    ReferenceCounts counts = previousArticle->getReferences();
+    diffReferences(counts,previousArticle->m_text,m_text,span);
+    setReferences(counts);
 }
 
 void Media::debugPrintInfo() const
@@ -214,12 +403,11 @@ void Media::debugPrintInfo() const
     qDebug() << " - Filename : " << getFileName();
 }
 
-QSet<QString> Media::parseData(QSet<QString> idSet) const
+void Media::countReferences(ReferenceCounts &counts) const
 {
-    /*! Polymorphic method : returns the list of the IDs contained in the description and in the filename of the media. */
-    idSet += getIDsFromText(getDescription());
-    idSet += getIDsFromText(getFileName());
-    return idSet;
+    /*! Polymorphic method : counts the references contained in the description and in the filename of the media. */
+    addReferences(counts,QStringRef(&m_description),1);
+    addReferences(counts,QStringRef(&m_filename),1);
 }
 
 
@@ -234,9 +422,8 @@ void Task::debugPrintInfo() const
 
 }
 
-QSet<QString> Task::parseData(QSet<QString> idSet) const
+void Task::countReferences(ReferenceCounts &counts) const
 {
-    /*! Polymorphic method : returns the list of the IDs contained in the description and in the action of the task. */
-    idSet += (getIDsFromText(getAction()));
-    return idSet;
+    /*! Polymorphic method : counts the references contained in the action of the task. */
+    addReferences(counts,QStringRef(&m_action),1);
 }
@@ -20,6 +20,22 @@ typedef enum ts {progress,standby,done} TaskStatus;
 typedef enum nt {ArticleType, MediaType, TaskType, EmptyType} NoteType;
 typedef QMap<QString,QVariant> Dico;
 typedef QList<Version*> ListVersion;
+typedef quint32 NoteHandle; /*!< Compact identifier of a note in the NotesManager, given at its creation. */
+typedef QHash<QString,int> ReferenceCounts; /*!< Number of references to each ID in a text. */
+
+/*! \struct EditedSpan
+ *  \brief Part of a text changed by the edits made since the text was loaded in an editor.
+ *
+ *  The text before start and the text after the end are the same in the old and in the new text.
+ */
+struct EditedSpan {
+    EditedSpan(int s = -1, int e = -1, int d = 0) : start(s), end(e), delta(d) {} /*!< Constructor. By default the span is unknown. */
+    bool isKnown() const { return start >= 0; } /*!< Returns true if the span was reported by the editor */
+
+    int start; /*!< Position of the first changed character ; -1 if the span is unknown */
+    int end; /*!< End of the changed part in the new text */
+    int delta; /*!< Size of the new text minus size of the old text ; the changed part ends at end - delta in the old text */
+};
 
 /*! \class NoteException
  * \brief Custom inheritance of the std::exception class.
@@ -43,13 +59,13 @@ private:
 class Note
 {
 public:
-    Note() : m_id("UNDEFINED"), m_type(EmptyType), m_creationDateTime(QDateTime(QDate(0,0,0))) {} /*! Necessary for Note to be declared as a MetaType, data included has to be considered as inoperant */
+    Note() : m_id("UNDEFINED"), m_type(EmptyType), m_creationDateTime(QDateTime(QDate(0,0,0))), m_historyLoaded(true), m_handle(0) {} /*! Necessary for Note to be declared as a MetaType, data included has to be considered as inoperant */
 
     //Regular constructors
     Note(const QString& id,const QString& title,const NoteType type,const QDateTime& creationDateTime=QDateTime::currentDateTime(),const NoteState& state=active)
-        : m_id(id), m_title(title),m_type(type),m_creationDateTime(creationDateTime),m_state(state) {} /*!< The canonical constructor of a Note. By default a Note is active and it created at the current runtime datetime */
+        : m_id(id), m_title(title),m_type(type),m_creationDateTime(creationDateTime),m_state(state),m_historyLoaded(true),m_handle(0) {} /*!< The canonical constructor of a Note. By default a Note is active and it created at the current runtime datetime */
 
-    ~Note(){ m_versions.clear(); } /*!< Destructor of the note : erase all the versions */
+    ~Note(); /*!< Destructor of the note : gives back its versions to the pools of the NotesManager */
     Note &operator=(const Note &n)
     {
         //The default operator= does not work
@@ -61,6 +77,7 @@ public:
     // Getters
     const QString getTitle() const {return m_title;} /*!< Getter for the title */
     const QString getId() const {return m_id;} /*!< Getter for the ID */
+    NoteHandle getHandle() const {return m_handle;} /*!< Getter for the handle given by the NotesManager */
     const QDateTime getCreationDateTime() const {return m_creationDateTime;} /*!< Getter for the date of creation */
     NoteType getType() const {return m_type;} /*!< Getter for the type */
     NoteState getState() const {return m_state; } /*!< Getter for the state */
@@ -70,6 +87,9 @@ public:
     void setState(NoteState s); /*!< Setter for the state */
 
     void createVersion(Dico& dico, bool fromPersistentData =false); /*!< Creates a new version of the note. */
+    void addVersion(Version *v); /*!< Adds an already built version as the most recent one. Used by the data manager when loading. */
+    void setHistoryLoaded(bool loaded) {m_historyLoaded = loaded;} /*!< Set to false when only the most recent versions were loaded : the older ones are fetched on demand. */
+    bool isHistoryLoaded() const {return m_historyLoaded;} /*!< Returns true if all the versions of the note are in memory. */
     Version *getLastversion();/*!< Get the most recent version of the note */
     const Version *getLastversion() const; /*!< Get the most recent version of the note */
 
@@ -84,14 +104,14 @@ public:
 
     /** Iterator on the versions of a note. Adapted from ListVersion::iterator via our custom iterators. */
     typedef customIterator::iterator<Version, ListVersion,Note> iterator;
-    iterator begin() { return iterator(m_versions.begin()); } /*!< Returns a iterator of versions set on the most recent version. */
-    iterator end() { return iterator(m_versions.end()); } /*!< Returns a iterator of versions set on the oldest version. */
+    iterator begin() { loadHistory(); return iterator(m_versions.begin()); } /*!< Returns a iterator of versions set on the most recent version. The older versions are loaded if needed. */
+    iterator end() { loadHistory(); return iterator(m_versions.end()); } /*!< Returns a iterator of versions set on the oldest version. The older versions are loaded if needed. */
 
 
     /** Const Iterator on the versions of a note. Adapted from ListVersion::const_iterator via our custom iterators. */
     typedef customIterator::const_iterator<Version, ListVersion,Note> const_iterator;
-    const_iterator cbegin() const { return const_iterator(m_versions.begin()); } /*!< Returns a iterator of versions set on the most recent version. */
-    const_iterator cend() const { return const_iterator(m_versions.end()); } /*!< Returns a iterator of versions set on the oldest version. */
+    const_iterator cbegin() const { loadHistory(); return const_iterator(m_versions.constBegin()); } /*!< Returns a iterator of versions set on the most recent version. The older versions are loaded if needed. */
+    const_iterator cend() const { loadHistory(); return const_iterator(m_versions.constEnd()); } /*!< Returns a iterator of versions set on the oldest version. The older versions are loaded if needed. */
 
 private:
     const QString m_id; /*!< The string that represents the ID of the note */
@@ -99,7 +119,13 @@ private:
     const NoteType m_type; /*!< The type of the note : ArticleType, MediaType or TaskType */
     const QDateTime m_creationDateTime; /*!< The date at which the note was created */
     NoteState m_state; /*!< The current state of the note : active, archive or bin */
-    ListVersion m_versions; /*!< The list of all the version on the note sorted by last date of modification */
+    mutable ListVersion m_versions; /*!< The list of all the version on the note sorted by last date of modification. Mutable since the history is loaded on demand. */
+    mutable bool m_historyLoaded; /*!< False while the versions older than the ones in m_versions are still in the persistent data */
+    NoteHandle m_handle; /*!< The handle of the note in the NotesManager */
+
+    friend class NotesManager;
+
+    void loadHistory() const; /*!< Fetches the older versions from the data manager the first time they are needed */
 };
 
 /*! \class Version
@@ -109,17 +135,27 @@ private:
  */
 class Version {
 public:
-  Version(const QDateTime& d=QDateTime::currentDateTime()) : m_modifDateTime(d){} /*!< The canonical Version constructor. The only argument isn't needed.*/
+  Version(const NoteType& type, const QDateTime& d=QDateTime::currentDateTime()) : m_type(type),m_modifDateTime(d),m_referencesKnown(false){} /*!< The canonical Version constructor, called by the inherited classes with their type. The date isn't needed.*/
   virtual ~Version() {} /*!< Virtual destructor */
 
-  virtual NoteType getType() const = 0; /*!< [Pure abstract] Returns the type of the version */
+  NoteType getType() const {return m_type;} /*!< Returns the type of the version. Stored in the version, so it is read without a virtual call. */
   virtual void debugPrintInfo() const = 0; /*!< [Pure abstract] Prints all the informations encapsulated in the Version */
 
-  virtual QSet<QString> parseData(QSet<QString> listID) const = 0; /*!< [Pure abstract] Parse all text entry to get id of referenced notes */
+  QSet<QString> parseData(QSet<QString> listID) const; /*!< Adds the IDs of the notes referenced by the version to listID */
+  const ReferenceCounts& getReferences() const; /*!< Returns the IDs referenced by the version and their number of references. Computed once, then cached. */
+  virtual void deriveReferences(const Version * previous, const EditedSpan& span) const { Q_UNUSED(previous); Q_UNUSED(span); } /*!< [Virtual] Computes the references from the ones of the previous version of the note, span being the part edited since it. By default they are computed on demand. */
 
   const QDateTime getModifDate() const { return m_modifDateTime; } /*!< Returns the date of modification */
+protected:
+  virtual void countReferences(ReferenceCounts& counts) const = 0; /*!< [Pure abstract] Counts the references in all the text entries of the version */
+  void setReferences(const ReferenceCounts& counts) const { m_references = counts; m_referencesKnown = true;} /*!< Sets the cache of the references */
+  static void addReferences(ReferenceCounts& counts, const QStringRef& text, int delta);
+  static void diffReferences(ReferenceCounts& counts, const QString& oldText, const QString& newText, const EditedSpan& span);
 private:
+  const NoteType m_type; /*!< The type of the version, given by the inherited class */
   const QDateTime m_modifDateTime; /*!< The date of modification of the note identificating the version */
+  mutable ReferenceCounts m_references; /*!< Cache of the references of the version. Mutable since it is computed on demand. */
+  mutable bool m_referencesKnown; /*!< True once m_references is computed */
 };
 
 
@@ -130,20 +166,24 @@ private:
 class Article : public Version
 {
 public:
-    Article() : Version() {} /*! Necessary for Article to be declared as a metatype */
-    Article(const QDateTime& modDate,const QString& tex):Version(modDate),m_text(tex){} /*!< Canonical constructor of an Article. */
+    static const NoteType staticType = ArticleType; /*!< The type of all the articles, used by version_cast */
+
+    Article() : Version(ArticleType) {} /*! Necessary for Article to be declared as a metatype */
+    Article(const QDateTime& modDate,const QString& tex):Version(ArticleType,modDate),m_text(tex){} /*!< Canonical constructor of an Article. */
 
     // Getters
-    virtual NoteType getType() const override {return ArticleType;} /*!< [Virtual] Getter for the type */
     QString getText() const {return m_text;} /*!< Getter for the text */
 
     virtual void debugPrintInfo() const override; /*!< [Virtual] Prints all the informations encapsulated in the Article */
 
-    virtual QSet<QString> parseData(QSet<QString> listID) const override; /*!< [Virtual] Parses all text entry to get id of referenced notes */
+    virtual void deriveReferences(const Version * previous, const EditedSpan& span) const override; /*!< [Virtual] Only the edited part of the text is parsed */
     // Setters
     void setText(const QString& text) {m_text = text;} /*!< Setter for the text */
 
 
+protected:
+    virtual void countReferences(ReferenceCounts& counts) const override; /*!< [Virtual] Counts the references in the text */
+
 private:
     QString m_text; /*!< The text of the article */
 
@@ -156,23 +196,25 @@ private:
 class Media : public Version
 {
 public:
-    Media() : Version(){} /*! Necessary for Media to be declared as a metatype */
-    Media(const QDateTime& modDate, const QString& descr,const QString& file=""):Version(modDate),m_description(descr),m_filename(file) {} /*!< Canonical constructor of a Media. */
+    static const NoteType staticType = MediaType; /*!< The type of all the media, used by version_cast */
+
+    Media() : Version(MediaType){} /*! Necessary for Media to be declared as a metatype */
+    Media(const QDateTime& modDate, const QString& descr,const QString& file=""):Version(MediaType,modDate),m_description(descr),m_filename(file) {} /*!< Canonical constructor of a Media. */
 
     // Getters
-    virtual NoteType getType() const override {return MediaType;} /*!< [Virtual] Getter for the type */
     QString getDescription() const {return m_description;} /*!< Getter for the description */
     QString getFileName() const {return m_filename;} /*!< Getter for the filename */
 
     virtual void debugPrintInfo() const override; /*!< [Virtual] Prints all the informations encapsulated in the Media */
 
-    virtual QSet<QString> parseData(QSet<QString> listID) const override; /*!< [Virtual] Parses all text entry to get id of referenced notes */
-
     // Setters
     void setDescription(QString d) {m_description = d;} /*!< Setter for the description */
     void setFileName(QString filename) {m_filename = filename;} /*!< Setter for the filename */
 
 
+protected:
+    virtual void countReferences(ReferenceCounts& counts) const override; /*!< [Virtual] Counts the references in the description and in the filename */
+
 private:
     QString m_description; /*!< The description of the media */
     QString m_filename; /*!< The file name of the media */
@@ -186,12 +228,13 @@ private:
 class Task : public Version
 {
 public:
-    Task() : Version(){} /*! Necessary for Task to be declared as a metatype */
+    static const NoteType staticType = TaskType; /*!< The type of all the tasks, used by version_cast */
+
+    Task() : Version(TaskType){} /*! Necessary for Task to be declared as a metatype */
     Task(const QDateTime& modDate,const QString& ac,TaskStatus stat,uint prio = 0, const QDateTime& deadL=QDateTime(QDate(0,0,0)))
-         :Version(modDate),m_action(ac),m_status(stat),m_priority(prio),m_deadLine(deadL) {} /*!< Canonical constructor of a Task. */
+         :Version(TaskType,modDate),m_action(ac),m_status(stat),m_priority(prio),m_deadLine(deadL) {} /*!< Canonical constructor of a Task. */
 
     // Getters
-    virtual NoteType getType() const override {return TaskType;} /*!< [Virtual] Getter for the type */
     QString getAction() const {return m_action; } /*!< Setter for the action */
     TaskStatus getStatus() const { return m_status;} /*!< Getter for the status */
     uint getPriority() const { return m_priority;} /*!< Getter for the priority */
@@ -199,8 +242,6 @@ public:
 
     virtual void debugPrintInfo() const override;  /*!< [Virtual] Prints all the informations encapsulated in the Task */
 
-    QSet<QString> parseData(QSet<QString> listID) const override; /*!< [Virtual] Parses all text entry to get id of referenced notes */
-
     // Setters
     void setAction(QString action) {m_action = action;} /*!< Setter for the action */
     void setStatus(TaskStatus status) { m_status = status;} /*!< Setter for the status */
@@ -208,6 +249,9 @@ public:
     void setDeadLine(QDateTime deadLine) {m_deadLine = deadLine; } /*!< Setter for the dead line */
 
 
+protected:
+    virtual void countReferences(ReferenceCounts& counts) const override; /*!< [Virtual] Counts the references in the action */
+
 private:
     QString m_action; /*!< The action of the task */
     TaskStatus m_status; /*!< The status of the task : progress, standby or done */
@@ -215,7 +259,19 @@ private:
     QDateTime m_deadLine; /*!< [Optionnal] The dead line of the task */
 };
 
+/*! Casts the version to the inherited class T (Article, Media or Task) by checking its type tag instead of the RTTI.
+ * Returns nullptr if the version isn't a T. */
+template<class T>
+T * version_cast(Version * version) { return (version != nullptr && version->getType() == T::staticType) ? static_cast<T*>(version) : nullptr; }
+
+/*! Const overload of version_cast. */
+template<class T>
+const T * version_cast(const Version * version) { return (version != nullptr && version->getType() == T::staticType) ? static_cast<const T*>(version) : nullptr; }
+
+
 
+QVector<QStringRef> findReferences(const QStringRef& text); /*!< Returns views on the IDs referenced in the text as "\\ref{id}". The views point in the string viewed by text. */
+QSet<QString> getIDsFromText(const QString& stringToFindIdWithin); /*!< Returns the set of the IDs referenced in the text as "\\ref{id}". */
 
 // Enables classes Article, Media and Task to be contained in a QVariant
 Q_DECLARE_METATYPE(Note)
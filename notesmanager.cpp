@@ -2,15 +2,55 @@
 #include <QSqlDatabase>
 #include <QSqlError>
 #include <QSqlQuery>
+#include <QtConcurrent>
+
+/*! \struct ReferenceSource
+ *  \brief Snapshot of the texts of a note, parsed by NotesManager::rebuildReferences() in a worker thread.
+ */
+struct ReferenceSource {
+    const Note * note; /*!< The note that references */
+    QString title; /*!< Copy of the title of the note */
+    const Version * version; /*!< The latest version of the note */
+};
+typedef QPair<const Note*,QSet<QString>> NoteReferences; /*!< A note and the IDs it references */
+typedef QHash<const Note*,QSet<QString>> ReferenceTargets; /*!< The IDs referenced by each note */
+
+static NoteReferences parseReferences(const ReferenceSource& source)
+{
+    /*! Map step of rebuildReferences() : returns the IDs referenced in the title and in the latest version of a note. */
+    QSet<QString> ids = getIDsFromText(source.title);
+    if (source.version)
+        ids = source.version->parseData(ids);
+    return qMakePair(source.note,ids);
+}
+
+static void collectReferences(ReferenceTargets& targets, const NoteReferences& references)
+{
+    /*! Reduce step of rebuildReferences() : gathers the references of all the notes. */
+    targets.insert(references.first,references.second);
+}
 
 NotesManager::Handler NotesManager::handler=Handler();
 
-NotesManager::NotesManager() : nbArticle(0), nbMedia(0),  nbTask(0)
+NotesManager::NotesManager()
 {
     dataManager = &(SQLiteManager::getInstance());
+    for (int state = 0; state < 3; state++)
+        for (int type = 0; type < 3; type++)
+            m_nbNotes[state][type] = 0;
 }
 
 
+NotesManager::~NotesManager()
+{
+    /*! Deletes all the notes ; their versions go back to the pools, which are destroyed after this body. */
+    qDeleteAll(m_notes);
+    m_notes.clear();
+    for (int state = 0; state < 3; state++)
+        m_notesByState[state].clear();
+    m_handles.clear();
+}
+
 NotesManager &NotesManager::getInstance()
 {
     /*! Returns the unique instance of the NotesManager. */
@@ -18,6 +58,14 @@ NotesManager &NotesManager::getInstance()
         handler.instance = new NotesManager;
         handler.instance->getDataManager().loadNotesAndVersions();
         handler.instance->getDataManager().loadRelationsAndCouples();
+        // The couples of the references are rebuilt from the contents of the notes once, when a migration asks for it.
+        // The task is done only once the rebuild is committed ; if the application stops in between, the rebuild
+        // runs again at the next start and finds nothing to change.
+        AbstractDataManager& dataManager = handler.instance->getDataManager();
+        if (dataManager.isTaskPending(TASK_REBUILD_REFERENCES)) {
+            handler.instance->rebuildReferences();
+            dataManager.setTaskDone(TASK_REBUILD_REFERENCES);
+        }
     }
     return *handler.instance;
 }
@@ -58,28 +106,18 @@ Note *NotesManager::createNote(const QString &id, const QString &title, const No
 {
     /*! Creates a new note ; adds it to the NotesManager and to the dataManager.
     creationDatetime is set by the default as the current DateTime and state to active */
+    if (type == EmptyType)
+        throw NoteException("NotesManager::createNote : bad type");
     Note * newNote = new Note(id,title,type,creationDateTime,state);
+    newNote->m_handle = m_handles.size();
+    m_handles.append(newNote);
     m_notes[id] = newNote;
-    // Is the Note is editable, we have to incremente the number of its type for the table view
-    if (newNote->isEditable()) {
-        switch(newNote->getType()){
-        case ArticleType:
-            nbArticle++;
-            break;
-        case MediaType:
-            nbMedia++;
-            break;
-        case TaskType:
-            nbTask++;
-            break;
-        case EmptyType:
-        default:
-            throw NoteException("NotesManager::createNote : bad type");
-        }
-    }
+    m_notesByState[state][id] = newNote;
+    m_nbNotes[state][type]++;
 
     if (saveInDB)
         dataManager->saveNote(*newNote,true); //toInsert set to True to insert in DB
+    emit noteCreated(newNote);
     return newNote;
 }
 
@@ -97,57 +135,65 @@ void NotesManager::deleteNote(const QString &id)
 {
     /*! Deletes or achives the note identified by the id :
      *  - If the note is referenced, we just archive it ;
-     *  - otherwise, we delete all its couples in all the relations and we set it in the bin. */
+     *  - otherwise, we delete all its couples in all the relations and we set it in the bin.
+     *  The writes are committed in one batch before the notes and the relations are changed in memory,
+     *  so a batch rolled back leaves them as they were. */
 
     Note * noteToDelete = findNote(id);
     if(!noteToDelete){
         throw NoteException("NotesManager::deleteNote : Note of id not present in the application.");
     }
-    if(noteToDelete->getState() == active)
-    {
-        switch(noteToDelete->getType())
-        {
-        case ArticleType:
-            nbArticle--;
-            break;
-        case MediaType:
-            nbMedia--;
-            break;
-        case TaskType:
-            nbTask--;
-            break;
-        case EmptyType:
-        default:
-            throw NoteException("NotesManager::deleteNote : bad type");
-        }
-    }
-
     NoteState currentState = noteToDelete->getState();
     if(currentState == dustbin) {
         return;
     }
 
     bool isReferenced = !(getNotesThatReference(noteToDelete).isEmpty());
-
-    if (isReferenced){
-        noteToDelete->toArchive();
+    NoteState newState = isReferenced ? archive : dustbin;
+    RelationCouples couplesToDelete;
+    if (!isReferenced)
+        couplesToDelete = getCouplesOfNote(noteToDelete);
+
+    // All the writes of the cascade are grouped in one batch
+    dataManager->beginBatch();
+    try {
+        for (RelationCouples::const_iterator it = couplesToDelete.cbegin(); it != couplesToDelete.cend(); ++it)
+            dataManager->deleteCouple(it->second,it->first->getName());
+        // The field 'state' is written with the new state ; it is set back if the batch fails
+        noteToDelete->m_state = newState;
+        dataManager->saveNote(*noteToDelete);
     }
-    else {
-        for(iteratorRelation itR = beginRelation(); itR != endRelation() ; itR++){
-            Relation::iterator itC = (*itR)->begin();
-            while(itC != (*itR)->end()) {
-                if ((*itC)->getAsc() == noteToDelete || (*itC)->getDesc()== noteToDelete){
-                    itC = (*itR)->deleteCouple(*itC);
-                }
-                else{
-                    itC++;
-                }
-            }
-        }
-        noteToDelete->toBin();
+    catch (...) {
+        noteToDelete->m_state = currentState;
+        dataManager->rollbackBatch();
+        throw;
+    }
+    if (!dataManager->commitBatch(true)) {
+        noteToDelete->m_state = currentState;
+        throw NoteException("NotesManager::deleteNote : the batch couldn't be committed.");
+    }
+
+    // The batch is committed : the memory follows
+    for (RelationCouples::const_iterator it = couplesToDelete.cbegin(); it != couplesToDelete.cend(); ++it)
+        it->first->removeCouple(it->second);
+    if (newState != currentState)
+        stateChanged(noteToDelete,currentState);
+}
+
+NotesManager::RelationCouples NotesManager::getCouplesOfNote(const Note *note)
+{
+    /*! Returns the couples of the note in all the relations, with the relation of each one. */
+    RelationCouples couples;
+    for(iteratorRelation itR = beginRelation(); itR != endRelation() ; itR++){
+        // A couple linking the note with itself is in both lists ; the set keeps it once
+        const QList<Couple*> outgoing = (*itR)->getOutgoingCouples(note);
+        for (QList<Couple*>::const_iterator itC = outgoing.cbegin(); itC != outgoing.cend(); ++itC)
+            couples.insert(qMakePair(*itR,*itC));
+        const QList<Couple*> incoming = (*itR)->getIncomingCouples(note);
+        for (QList<Couple*>::const_iterator itC = incoming.cbegin(); itC != incoming.cend(); ++itC)
+            couples.insert(qMakePair(*itR,*itC));
     }
-    // We update the field 'state' in via the dataManager
-    dataManager->saveNote(*noteToDelete);
+    return couples;
 }
 
 void NotesManager::changeState(const QString &id, const NoteState &state)
@@ -158,21 +204,27 @@ void NotesManager::changeState(const QString &id, const NoteState &state)
         throw NoteException("NotesManager::changeState : note isn't present.");
     }
     n->setState(state);
-    switch(n->getType())
-    {
-    case ArticleType:
-        state ? nbArticle-- : nbArticle++;
-        break;
-    case MediaType:
-        state ? nbMedia-- : nbMedia++;
-        break;
-    case TaskType:
-        state ? nbTask-- : nbTask++;
-        break;
-    case EmptyType:
-    default:
-        throw NoteException("NotesManager::changeState : bad type");
-    }
+}
+
+void NotesManager::stateChanged(Note *note, const NoteState &oldState)
+{
+    /*! Called by Note::setState : moves the note to the index of its new state, updates the counters
+     * and notifies the views. */
+    m_notesByState[oldState].remove(note->getId());
+    m_nbNotes[oldState][note->getType()]--;
+    m_notesByState[note->getState()][note->getId()] = note;
+    m_nbNotes[note->getState()][note->getType()]++;
+    emit noteStateChanged(note,oldState);
+}
+
+NotesManager::iteratorNote NotesManager::eraseNote(const NotesManager::iteratorNote &it)
+{
+    /*! Erases a note based on an iterator pointing on it, in m_notes and in the index of its state. */
+    Note * noteToErase = it.m_iterator.value();
+    m_notesByState[noteToErase->getState()].remove(noteToErase->getId());
+    m_nbNotes[noteToErase->getState()][noteToErase->getType()]--;
+    m_handles[noteToErase->getHandle()] = nullptr;
+    return iteratorNote(m_notes.erase(it.m_iterator));
 }
 
 void NotesManager::triggerArchivedSubSet() {
@@ -233,30 +285,60 @@ void NotesManager::triggerArchivedSubSet() {
 void NotesManager::emptyBin()
 {
     /*! Empties the bin and erases all the notes with the state 'dustbin' */
-    iteratorNote it = beginNote();
-    QSqlQuery query;
-    while(it != endNote()){
-        if ((*it)->getState()==dustbin) {
+    // Only the notes of the bin are visited ; they are erased from the data in one batch,
+    // then from the memory once the batch is committed
+    const QList<Note*> notesToErase = m_notesByState[dustbin].values();
+    if (notesToErase.isEmpty())
+        return;
+    // No couple may keep pointing on an erased note ; a couple between two notes of the bin is deleted once
+    RelationCouples couplesToDelete;
+    for (QList<Note*>::const_iterator it = notesToErase.cbegin(); it != notesToErase.cend(); ++it)
+        couplesToDelete.unite(getCouplesOfNote(*it));
+
+    dataManager->beginBatch();
+    try {
+        for (RelationCouples::const_iterator it = couplesToDelete.cbegin(); it != couplesToDelete.cend(); ++it)
+            dataManager->deleteCouple(it->second,it->first->getName());
+        for (QList<Note*>::const_iterator it = notesToErase.cbegin(); it != notesToErase.cend(); ++it)
             dataManager->deleteNote(*it);
-            // Erasing in the NotesManager
-            it = eraseNote(it);
-        }
-        else {
-            it++;
-        }
+    }
+    catch (...) {
+        dataManager->rollbackBatch();
+        throw;
+    }
+    if (!dataManager->commitBatch(true))
+        throw NoteException("NotesManager::emptyBin : the batch couldn't be committed.");
+
+    // The batch is committed : the memory follows
+    for (RelationCouples::const_iterator it = couplesToDelete.cbegin(); it != couplesToDelete.cend(); ++it)
+        it->first->removeCouple(it->second);
+    for (QList<Note*>::const_iterator it = notesToErase.cbegin(); it != notesToErase.cend(); ++it) {
+        Note * noteToErase = *it;
+        emit noteErased(noteToErase);
+        // Erasing in the NotesManager ; the versions of the note go back to the pools
+        eraseNote(iteratorNote(m_notes.find(noteToErase->getId())));
+        delete noteToErase;
     }
 }
 
-uint NotesManager::nbNotesInBin() const
+void NotesManager::releaseVersion(Version *version)
 {
-    /*! Returns the number of notes in the bin. */
-    uint nbNotes = 0;
-    QSqlQuery query;
-    for(const_iteratorNote it = cbeginNote();it != cendNote();it++){
-        if ((*it)->getState()==dustbin)
-            nbNotes++;
+    /*! Destroys a version and gives back its slot to the pool of its type. */
+    if (version == nullptr)
+        return;
+    switch (version->getType()) {
+    case ArticleType:
+        m_articlePool.release(static_cast<Article*>(version));
+        break;
+    case MediaType:
+        m_mediaPool.release(static_cast<Media*>(version));
+        break;
+    case TaskType:
+        m_taskPool.release(static_cast<Task*>(version));
+        break;
+    default:
+        throw NoteException("NotesManager::releaseVersion : type problem");
     }
-    return nbNotes;
 }
 
 Relation *NotesManager::findRelation(const QString &name)
@@ -281,6 +363,7 @@ Relation *NotesManager::createRelation(const QString &name, const QString &descr
     m_relations[name] = newRelation;
     if (saveInDB)
         dataManager->saveRelation(*newRelation,true); //toInsert set to true
+    emit relationCreated(newRelation);
     return newRelation;
 }
 
@@ -294,16 +377,12 @@ QSet<pair<QString,QString>> NotesManager::getCouplesWithNote(const Note * noteTo
     Relation * relationToFindCouplesWithin = findRelation(relationName);
     if (relationToFindCouplesWithin == nullptr)
         throw NoteException("NotesManager::getCouplesWithNote : relation not found.");
-    for (Relation::iterator it = relationToFindCouplesWithin->begin(); it != relationToFindCouplesWithin->end();it++) {
-        if (findAsc && (*it)->getAsc()->getId() == noteToFind->getId()){
-            pair<QString,QString> toInsert = make_pair((*it)->getDesc()->getId(),(*it)->getLabel());
-            idSet.insert(toInsert);
-
-        }
-        else if (!findAsc && (*it)->getDesc()->getId() == noteToFind->getId()){
-            pair<QString,QString> toInsert = make_pair((*it)->getAsc()->getId(),(*it)->getLabel());
-            idSet.insert(toInsert);
-        }
+    // Only the couples of the note are visited, via the adjacency lists of the relation
+    const QList<Couple*> couples = findAsc ? relationToFindCouplesWithin->getOutgoingCouples(noteToFind)
+                                           : relationToFindCouplesWithin->getIncomingCouples(noteToFind);
+    for (QList<Couple*>::const_iterator it = couples.cbegin(); it != couples.cend(); it++) {
+        const Note * otherNote = findAsc ? (*it)->getDesc() : (*it)->getAsc();
+        idSet.insert(make_pair(otherNote->getId(),(*it)->getLabel()));
     }
     return idSet;
 }
@@ -320,6 +399,74 @@ QSet<QString> NotesManager::getReferencedNotes(const Note * noteThatReferences)
     return refSet;
 }
 
+int NotesManager::rebuildReferences()
+{
+    /*! Recomputes the whole relation Référence from the contents of the notes.
+     * The latest versions are parsed in parallel (map-reduce over the notes that aren't in the bin), then the
+     * wanted couples are compared to the existing ones and the differences are written in one batch. The relation
+     * is changed in memory only once the batch is committed, so a batch rolled back leaves it as it was.
+     * Returns the number of couples created or deleted. */
+    Relation * referenceRelation = findRelation("Référence");
+    if (referenceRelation == nullptr)
+        throw NoteException("NotesManager::rebuildReferences : relation Référence not found.");
+
+    // The snapshot is taken in this thread ; the workers only read the titles and the versions
+    QVector<ReferenceSource> sources;
+    sources.reserve(m_notesByState[active].size() + m_notesByState[archive].size());
+    const NoteState states[2] = {active,archive};
+    for (int i = 0; i < 2; i++) {
+        for (const_iteratorNote it = cbeginNote(states[i]); it != cendNote(states[i]); ++it) {
+            ReferenceSource source = {*it,(*it)->getTitle(),(*it)->getLastversion()};
+            sources.append(source);
+        }
+    }
+    const ReferenceTargets targets = QtConcurrent::blockingMappedReduced<ReferenceTargets>(sources,parseReferences,collectReferences);
+
+    // Difference between the wanted couples and the existing ones
+    QList<PairNotes> couplesToCreate;
+    QList<Couple*> couplesToDelete;
+    for (ReferenceTargets::const_iterator it = targets.cbegin(); it != targets.cend(); ++it) {
+        const Note * note = it.key();
+        QSet<const Note*> wanted;
+        for (QSet<QString>::const_iterator itId = it.value().cbegin(); itId != it.value().cend(); ++itId) {
+            const Note * target = m_notes.value(*itId,nullptr);
+            // Hypothesis : a note doesn't references itself ; the notes of the bin can't be referenced
+            if (target && target != note && target->getState() != dustbin)
+                wanted.insert(target);
+        }
+        const QList<Couple*> existing = referenceRelation->getOutgoingCouples(note);
+        for (QList<Couple*>::const_iterator itC = existing.cbegin(); itC != existing.cend(); ++itC) {
+            if (!wanted.remove((*itC)->getDesc()))
+                couplesToDelete.append(*itC);
+        }
+        for (QSet<const Note*>::const_iterator itW = wanted.cbegin(); itW != wanted.cend(); ++itW)
+            couplesToCreate.append(make_pair(note,*itW));
+    }
+    if (couplesToCreate.isEmpty() && couplesToDelete.isEmpty())
+        return 0;
+
+    dataManager->beginBatch();
+    try {
+        for (QList<Couple*>::const_iterator it = couplesToDelete.cbegin(); it != couplesToDelete.cend(); ++it)
+            dataManager->deleteCouple(*it,referenceRelation->getName());
+        for (QList<PairNotes>::const_iterator it = couplesToCreate.cbegin(); it != couplesToCreate.cend(); ++it)
+            dataManager->saveCouple(Couple(it->first,it->second),referenceRelation->getName(),true);
+    }
+    catch (...) {
+        dataManager->rollbackBatch();
+        throw;
+    }
+    if (!dataManager->commitBatch(true))
+        throw NoteException("NotesManager::rebuildReferences : the batch couldn't be committed.");
+
+    // The batch is committed : the memory follows
+    for (QList<Couple*>::const_iterator it = couplesToDelete.cbegin(); it != couplesToDelete.cend(); ++it)
+        referenceRelation->removeCouple(*it);
+    for (QList<PairNotes>::const_iterator it = couplesToCreate.cbegin(); it != couplesToCreate.cend(); ++it)
+        referenceRelation->createCouple(it->first,it->second,"",false);
+    return couplesToDelete.size() + couplesToCreate.size();
+}
+
 QSet<QString> NotesManager::getNotesThatReference(const Note * noteThatIsReferenced) {
     /*! Returns the list of ID of the notes that reference 'noteThatReferences'. */
 
@@ -12,6 +12,8 @@
 #include <string>
 #include <iostream>
 #include "datamanager.h"
+#include "versionpool.h"
+#include <QObject>
 
 typedef QMap<QString,Note*> DicoNotes;
 typedef QMap<QString,Relation*> DicoRelations;
@@ -20,41 +22,54 @@ typedef QMap<QString,Relation*> DicoRelations;
 /*! \class NotesManager
  * \brief Class that manages all the data and their
  *
- *  Is implemented under the Singleton Design Pattern
+ *  Is implemented under the Singleton Design Pattern.
+ *  The changes made on the notes are notified with signals, so the views can update themselves incrementally.
  */
-class NotesManager
+class NotesManager : public QObject
 {
+    Q_OBJECT
 public:
     static NotesManager& getInstance(); /*!< Gives tha unique instance of the NotesManager */
     static void freeManager(); /*!< Free the memory used by the NotesManager; it can be rebuild later */
 
     // Getters
-    uint getNbArticles() const {return nbArticle;} /*!< Returns the number of articles */
-    uint getNbMedia() const {return nbMedia;} /*!< Returns the number of media */
-    uint getNbTask() const {return nbTask;} /*!< Returns the number of tasks */
-    uint getNbNotes() const {return getNbArticles()+getNbArticles()+getNbTask();} /*!< Returns the total number of notes */
+    uint getNbNotes(const NoteState& state, const NoteType& type) const {return m_nbNotes[state][type];} /*!< Returns the number of notes of this state and this type */
+    uint getNbArticles() const {return getNbNotes(active,ArticleType);} /*!< Returns the number of active articles */
+    uint getNbMedia() const {return getNbNotes(active,MediaType);} /*!< Returns the number of active media */
+    uint getNbTask() const {return getNbNotes(active,TaskType);} /*!< Returns the number of active tasks */
+    uint getNbNotes() const {return getNbArticles()+getNbMedia()+getNbTask();} /*!< Returns the total number of active notes */
 
     AbstractDataManager& getDataManager() {return *dataManager;} /*!< Returns the datamanager used in the application.*/
 
+    // Allocation of the versions in the pools
+    Article * newArticle(const QDateTime& modDate, const QString& text) {return m_articlePool.create(modDate,text);} /*!< Builds an Article in the pool of the articles */
+    Media * newMedia(const QDateTime& modDate, const QString& description, const QString& filename) {return m_mediaPool.create(modDate,description,filename);} /*!< Builds a Media in the pool of the media */
+    Task * newTask(const QDateTime& modDate, const QString& action, TaskStatus status, uint priority, const QDateTime& deadLine) {return m_taskPool.create(modDate,action,status,priority,deadLine);} /*!< Builds a Task in the pool of the tasks */
+    void releaseVersion(Version * version);
+    const VersionPool<Article>& getArticlePool() const {return m_articlePool;} /*!< Returns the pool of the articles, to walk through all of them with forEachAlive() */
+    const VersionPool<Media>& getMediaPool() const {return m_mediaPool;} /*!< Returns the pool of the media, to walk through all of them with forEachAlive() */
+    const VersionPool<Task>& getTaskPool() const {return m_taskPool;} /*!< Returns the pool of the tasks, to walk through all of them with forEachAlive() */
+    int getNbVersionsAlive() const {return m_articlePool.getNbAlive()+m_mediaPool.getNbAlive()+m_taskPool.getNbAlive();} /*!< Returns the number of versions currently in memory */
+
     // Creation and management of objects (Note and Relation)
     Note * createNote(const QString &id, const QString &title, const NoteType type, const QDateTime& creationDateTime=QDateTime::currentDateTime(), const NoteState& state=active,bool saveInDB = true);
     Note * findNote(const QString& id); /*!< Returns the note based on the id. nullptr is returned if the notes doesn't exist. */
+    Note * getNote(NoteHandle handle) const { return handle < uint(m_handles.size()) ? m_handles.at(handle) : nullptr;} /*!< Returns the note based on its handle, in constant time. nullptr is returned if the note was erased. */
     void deleteNote(const QString& id);
 
     bool isPresent(const QString &id) { return (findNote(id) != nullptr);} /*!< Returns true if a Note with this ID is present. */
     void changeState(const QString &id, const NoteState &state);
     void emptyBin();
-    uint nbNotesInBin() const;
+    uint nbNotesInBin() const { return m_notesByState[dustbin].size();} /*!< Returns the number of notes in the bin. */
     void triggerArchivedSubSet();
 
     Relation * createRelation(const QString &name, const QString &description, const bool &isOriented=true,bool saveInDB = true);
     Relation * findRelation(const QString& name);
 
-    int getRowCount() const {return max(max(nbArticle, nbMedia), nbTask);} /*!< Used by the model to know the right number of rows to show */
-
     QSet<pair<QString,QString>> getCouplesWithNote(const Note *noteToFind, const QString& relationName, bool findAsc = true);
     QSet<QString> getReferencedNotes(const Note * noteThatReferences);
     QSet<QString> getNotesThatReference(const Note * noteThatIsReferenced);
+    int rebuildReferences();
 
 
     // DEBUG functions
@@ -66,7 +81,10 @@ public:
 
     iteratorNote beginNote() {return iteratorNote(m_notes.begin());} /*!< Returns a iterator of notes set on the first note (the notes are sorted alphabeticaly on their ID). */
     iteratorNote endNote() {return iteratorNote(m_notes.end());} /*!< Returns a iterator of notes set on the last note (the notes are sorted alphabeticaly on their ID). */
-    iteratorNote eraseNote(const iteratorNote& it) { return iteratorNote(m_notes.erase(it.m_iterator)); } /*!< Erase a note based on an iterator pointing on it. */
+    iteratorNote eraseNote(const iteratorNote& it);
+
+    iteratorNote beginNote(const NoteState& state) {return iteratorNote(m_notesByState[state].begin());} /*!< Returns a iterator set on the first note of this state (sorted alphabeticaly on their ID). */
+    iteratorNote endNote(const NoteState& state) {return iteratorNote(m_notesByState[state].end());} /*!< Returns a iterator set after the last note of this state. */
 
     /**  Const Iterator on the notes used in the application. Adapted from DicoNotes::const_iterator via our custom iterators. */
     typedef  customIterator::const_iterator<Note, DicoNotes,NotesManager> const_iteratorNote;
@@ -74,6 +92,9 @@ public:
     const_iteratorNote cbeginNote() const {return const_iteratorNote(m_notes.begin());} /*!< Returns a iterator of notes set on the first note (the notes are sorted alphabeticaly on their ID). */
     const_iteratorNote cendNote() const {return const_iteratorNote(m_notes.end());} /*!< Returns a iterator of notes set on the last note (the notes are sorted alphabeticaly on their ID). */
 
+    const_iteratorNote cbeginNote(const NoteState& state) const {return const_iteratorNote(m_notesByState[state].begin());} /*!< Returns a iterator set on the first note of this state (sorted alphabeticaly on their ID). */
+    const_iteratorNote cendNote(const NoteState& state) const {return const_iteratorNote(m_notesByState[state].end());} /*!< Returns a iterator set after the last note of this state. */
+
 
     /**  Iterator on the relations used in the application. Adapted from DicoRelations::iterator via our custom iterators. */
     typedef  customIterator::iterator<Relation, DicoRelations,NotesManager> iteratorRelation;
@@ -85,9 +106,24 @@ public:
     const_iteratorRelation cbeginRelation() const {return const_iteratorRelation(m_relations.begin());} /*!< Returns a iterator of relations set on the first relation (the relations are sorted alphabeticaly on their name). */
     const_iteratorRelation cendRelation() const {return const_iteratorRelation(m_relations.end());} /*!< Returns a iterator of relations set on the last relation (the relations are sorted alphabeticaly on their name). */
 
+signals:
+    void noteCreated(Note * note); /*!< Emitted when a note is added in the NotesManager. */
+    void noteVersionAdded(Note * note); /*!< Emitted when the application creates a new version of a note. */
+    void noteStateChanged(Note * note, NoteState oldState); /*!< Emitted when the state of a note changes. */
+    void noteTitleChanged(Note * note); /*!< Emitted when the title of a note changes. */
+    void noteErased(Note * note); /*!< Emitted just before a note is erased from the NotesManager. */
+    void relationCreated(Relation * relation); /*!< Emitted when a relation is added in the NotesManager. */
+    void coupleAdded(Relation * relation, Couple * couple); /*!< Emitted when a couple is added in a relation. */
+    void coupleRemoved(Relation * relation, Couple * couple); /*!< Emitted just before a couple is removed from a relation. */
+
 private:
+    friend class Note;
     NotesManager();
-    ~NotesManager() {}
+    ~NotesManager();
+
+    void stateChanged(Note * note, const NoteState& oldState);
+    typedef QSet<QPair<Relation*,Couple*>> RelationCouples; /*!< Couples, each one with the relation it belongs to */
+    RelationCouples getCouplesOfNote(const Note * note); /*!< Returns the couples of the note in all the relations */
 
     /*! \struct NotesManager::Handler
      *  \brief The class that handles the unique instance of NotesManager for the Singleton.
@@ -101,10 +137,13 @@ private:
     static Handler handler; /*!< The handler of the unique instance of the manager */
     AbstractDataManager * dataManager; /*!< The specific data manager used for the data persistance */
     DicoNotes m_notes; /*!< Map the notes indexed by their ID */
+    DicoNotes m_notesByState[3]; /*!< The notes of m_notes split by state, indexed by their ID */
+    uint m_nbNotes[3][3]; /*!< Number of notes of each state (first index) and each type (second index) */
     DicoRelations m_relations; /*!< Map the relations indexed by their names */
-    uint nbArticle; /*!< Number of articles in the NotesManager */
-    uint nbMedia; /*!< Number of media in the NotesManager */
-    uint nbTask; /*!< Number of tasks in the NotesManager */
+    QVector<Note*> m_handles; /*!< The notes indexed by their handle. The handles of the erased notes aren't reused. */
+    VersionPool<Article> m_articlePool; /*!< Pool of the versions of the articles. The pools are destroyed after the body of ~NotesManager, so after the notes. */
+    VersionPool<Media> m_mediaPool; /*!< Pool of the versions of the media */
+    VersionPool<Task> m_taskPool; /*!< Pool of the versions of the tasks */
 };
 
 #endif // NOTEMANAGER_H
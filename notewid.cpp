@@ -1,6 +1,8 @@
 #include "notewid.h"
+#include "thumbnailservice.h"
 
 const QString DATEFORMAT = "yyyy-MM-dd hh:mm:ss";
+const QSize THUMBNAILSIZE(400,400); // The images are shown downscaled to fit in this size
 
 
 InterfaceStrategy::InterfaceStrategy(const QString &id, const QString &title, const QString &creat, const QString &modif)
@@ -168,12 +170,15 @@ void InterfaceStrategy::submitButtonClicked()
 
 
 ArticleStrategy::ArticleStrategy(const QString &id, const QString &title, const QString &text, const QString &creat, const QString &modif)
-    : InterfaceStrategy(id, title, creat, modif)
+    : InterfaceStrategy(id, title, creat, modif), m_spanTracked(false), m_editStart(-1), m_editEnd(-1), m_editDelta(0)
 {
 
      /*! Defines the interface specific to an article */
     textEdit = new QTextEdit;
 
+    // The changes of the document give the part of the text to parse again for the references
+    connect(textEdit->document(), &QTextDocument::contentsChange, this, [=](int position, int removed, int added){widenEditedSpan(position,removed,added);});
+
     //Show data
      setText(text);
 
@@ -186,8 +191,33 @@ ArticleStrategy::~ArticleStrategy()
 
 void ArticleStrategy::setText(const QString &t)
 {
-     /*! Setter for the text */
+     /*! Setter for the text. The edited part is reset : the next edits are relative to t. */
     textEdit->setText(t);
+    // A text read as rich text doesn't have the positions of t in the document
+    m_spanTracked = (textEdit->document()->characterCount() - 1 == t.size());
+    m_editStart = -1;
+    m_editEnd = -1;
+    m_editDelta = 0;
+}
+
+void ArticleStrategy::widenEditedSpan(int position, int removed, int added)
+{
+    /*! Called on each change of the document : the edited part becomes the union of itself and of the changed characters,
+     * in the positions of the current text. */
+    int end = position + added;
+    if (m_editStart >= 0) {
+        // The previous end is moved by the change
+        int previousEnd = m_editEnd;
+        if (previousEnd >= position + removed)
+            previousEnd += added - removed;
+        else if (previousEnd > position)
+            previousEnd = position + added;
+        end = qMax(end,previousEnd);
+        position = qMin(position,m_editStart);
+    }
+    m_editStart = position;
+    m_editEnd = end;
+    m_editDelta += added - removed;
 }
 
 Dico ArticleStrategy::getData() const
@@ -198,6 +228,11 @@ Dico ArticleStrategy::getData() const
     dataToSend["id"] = getID();
     dataToSend["title"] = getTitle();
     dataToSend["text"] = textEdit->toPlainText();
+    if (m_spanTracked && m_editStart >= 0) {
+        dataToSend["editStart"] = m_editStart;
+        dataToSend["editEnd"] = m_editEnd;
+        dataToSend["editDelta"] = m_editDelta;
+    }
 
     return dataToSend;
 }
@@ -224,7 +259,7 @@ void ArticleStrategy::loadCompleteInterface(bool readOnly)
 
 
 MediaStrategy::MediaStrategy(const QString &id,const QString &title,const QString &description,const QString &filename, const QString &creat, const QString &modif) :
-    InterfaceStrategy(id, title, creat, modif), labelFile("Fichier: "), labelImage(filename), regex(".(mp3|mp4|avi|jpg|png)$"),
+    InterfaceStrategy(id, title, creat, modif), labelFile("Fichier: "), labelImage(filename), labelDuration(""), regex(".(mp3|mp4|avi|jpg|png)$"),
     imageDisplayer(nullptr), imgLayout(nullptr), mediaplayer(nullptr), videoDisplayer(nullptr), playButton(nullptr)
 {
      /*! Defines the interface specific to an article */
@@ -248,6 +283,13 @@ MediaStrategy::MediaStrategy(const QString &id,const QString &title,const QStrin
 
     playButton->setIcon(style()->standardIcon(QStyle::SP_MediaPause));
 
+    imgLayout->addWidget(&labelImage);
+    imageDisplayer->setLayout(imgLayout);
+
+    // The thumbnails and the durations are computed in the background
+    ThumbnailService& thumbnails = ThumbnailService::getInstance();
+    connect(&thumbnails, &ThumbnailService::thumbnailReady, this, &MediaStrategy::thumbnailReady);
+    connect(&thumbnails, &ThumbnailService::durationReady, this, &MediaStrategy::durationReady);
 
 
     //Show data
@@ -280,9 +322,8 @@ void MediaStrategy::setDescription(const QString &desc)
 
 void MediaStrategy::setFileName(const QString &f)
 {
-     /*! Setter for the fileEdit and load the media */
+     /*! Setter for the fileEdit ; the media is loaded by setFormatedWidget() */
     fileEdit->setText(f);
-    labelImage.setPixmap(QPixmap(fileEdit->text()));// A suppr?
 
 }
 
@@ -359,6 +400,7 @@ void MediaStrategy::loadCompleteInterface(bool readOnly)
         layout->insertWidget(layout->count()-1,imageDisplayer);
         layout->setAlignment(imageDisplayer, Qt::AlignHCenter);
         layout->insertWidget(layout->count()-1, playButton);
+        layout->insertWidget(layout->count()-1, &labelDuration);
         //layout->insertWidget(layout->count()-1,videoDisplayer);
 
         //Insert the specific widget before the submit button
@@ -382,6 +424,9 @@ void MediaStrategy::setFormatedWidget(const QString &filename)
     }
 
     mediaplayer->stop();
+    m_imageFile.clear();
+    m_mediaFile.clear();
+    labelDuration.hide();
 
 
     if((formatMatched == ".jpg") || (formatMatched == ".png"))
@@ -390,8 +435,11 @@ void MediaStrategy::setFormatedWidget(const QString &filename)
         playButton->hide();
         imageDisplayer->show();
 
-        imgLayout->addWidget(&labelImage);
-        imageDisplayer->setLayout(imgLayout);
+        // The image is decoded in the background ; its thumbnail is shown when it is ready
+        m_imageFile = filename;
+        labelImage.setPixmap(QPixmap());
+        labelImage.setText("Chargement...");
+        ThumbnailService::getInstance().requestThumbnail(filename, THUMBNAILSIZE);
     }
     else if((formatMatched == ".mp3") || (formatMatched == ".wav"))
     {
@@ -399,7 +447,14 @@ void MediaStrategy::setFormatedWidget(const QString &filename)
         imageDisplayer->hide();        
         playButton->show();
 
-        mediaplayer->setMedia(QUrl::fromLocalFile(filename));
+        // The source is only set again if the file changed
+        if(m_mediaSource != filename)
+        {
+            mediaplayer->setMedia(QUrl::fromLocalFile(filename));
+            m_mediaSource = filename;
+        }
+        m_mediaFile = filename;
+        ThumbnailService::getInstance().requestDuration(filename);
         mediaplayer->setVolume(50);
         mediaplayer->play();
     }
@@ -409,14 +464,41 @@ void MediaStrategy::setFormatedWidget(const QString &filename)
         imageDisplayer->hide();
         videoDisplayer->show();
         playButton->show();
-        mediaplayer->setMedia(QUrl::fromLocalFile(filename));
-        mediaplayer->setVideoOutput(videoDisplayer);
+        if(m_mediaSource != filename)
+        {
+            mediaplayer->setMedia(QUrl::fromLocalFile(filename));
+            mediaplayer->setVideoOutput(videoDisplayer);
+            m_mediaSource = filename;
+        }
+        m_mediaFile = filename;
+        ThumbnailService::getInstance().requestDuration(filename);
         mediaplayer->setVolume(50);
         mediaplayer->play();
 
     }
 }
 
+void MediaStrategy::thumbnailReady(const QString &path, const QImage &image)
+{
+    /*! Shows the thumbnail if it is the one of the image selected */
+
+    if(path != m_imageFile)
+        return;
+    labelImage.setPixmap(QPixmap::fromImage(image));
+}
+
+void MediaStrategy::durationReady(const QString &path, qint64 duration)
+{
+    /*! Shows the duration if it is the one of the media selected */
+
+    if(path != m_mediaFile)
+        return;
+    labelDuration.setText(QString("Durée : %1").arg(QTime(0,0).addMSecs(duration).toString(duration >= 3600000 ? "h:mm:ss" : "m:ss")));
+    // Not shown as a window before the label is in the interface
+    if(labelDuration.parentWidget() != nullptr)
+        labelDuration.show();
+}
+
 TaskStrategy::TaskStrategy(const QString &id, const QString &title, const QString &action, int prio, const QDateTime &deadL, const QString &creat, const QString &modif)
     : InterfaceStrategy(id, title, creat, modif),labelPrio("Priorité: "), labelDeadline("Deadline: ")
 {
@@ -101,8 +101,13 @@ public:
 private:
 
     QTextEdit *textEdit;  /*!< Text editor at the middle of the widget */
+    bool m_spanTracked; /*!< False if the document of textEdit does not match the text given to setText, so its positions can't be used */
+    int m_editStart; /*!< Start of the part of the text edited since setText ; -1 if nothing was edited */
+    int m_editEnd; /*!< End of the edited part in the current text */
+    int m_editDelta; /*!< Size of the current text minus size of the text given to setText */
 
     virtual void loadCompleteInterface(bool readOnly);
+    void widenEditedSpan(int position, int removed, int added); /*!< Widens the edited part to a change of the document */
 
 
 };
@@ -132,9 +137,14 @@ public slots:
     void chooseFileName();
     void play();
 
+private slots:
+    void thumbnailReady(const QString &path, const QImage &image);
+    void durationReady(const QString &path, qint64 duration);
+
 private:
     QLabel labelFile;  /*!< Label before the file */
     QLabel labelImage;  /*!< Label that shows an image */
+    QLabel labelDuration;  /*!< Label that shows the duration of a sound or a video */
 
     QTextEdit *textEdit;  /*!< Text editor at the middle of the widget */
 
@@ -150,6 +160,9 @@ private:
     QMediaPlayer *mediaplayer; /*!< Play a media, such as a song or a video */
     QVideoWidget *videoDisplayer; /*!< Displays the video */
     QPushButton *playButton; /*!< Button to play or to pause the mediaplayer */
+    QString m_imageFile; /*!< The image whose thumbnail is shown or awaited */
+    QString m_mediaFile; /*!< The sound or the video whose duration is shown or awaited */
+    QString m_mediaSource; /*!< The file currently loaded in the mediaplayer */
 
     virtual void loadCompleteInterface(bool readOnly);
     void setFormatedWidget(const QString &filename);
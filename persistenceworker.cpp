@@ -0,0 +1,264 @@
+#include "persistenceworker.h"
+
+const QString WRITERCONNECTION = "plurinotesWriter";
+
+PersistenceWorker::PersistenceWorker(const QString &databaseName, int capacity)
+    : m_databaseName(databaseName), m_capacity(capacity), m_queuedRecords(0), m_inFlight(0), m_stopping(false),
+      m_nbEnqueued(0), m_nbApplied(0), m_maxQueueDepth(0), m_nbCommits(0), m_lastCommitLatency(0), m_totalCommitLatency(0), m_nbFailedBatches(0), m_nbBlockedEnqueues(0)
+{
+    /*! The canonical constructor of the worker. The thread has to be started with start(). */
+}
+
+PersistenceWorker::~PersistenceWorker()
+{
+    /*! The destructor applies the writes still in the queue before the thread ends. */
+    stop();
+}
+
+quint64 PersistenceWorker::enqueue(const WriteRecord &record)
+{
+    /*! Adds a write to the queue, in a batch of its own. If the queue is full, the caller waits for the worker to take writes from it. */
+    return enqueue(WriteBatch() << record);
+}
+
+quint64 PersistenceWorker::enqueue(const WriteBatch &batch, bool waited)
+{
+    /*! Adds a batch of writes. The batch is kept whole in the queue, so the worker applies all its writes or none of them.
+     * If it doesn't fit in the queue, the caller waits for the queue to be empty : this backpressure is wanted, the queue
+     * must not grow without bound when the disk is slower than the edits. The waits are counted by getNbBlockedEnqueues().
+     * Returns the ticket of the batch, to wait for it with flush(ticket). If waited is true, the caller has to call
+     * flush(ticket) : it gets the error there, and batchesFailed() doesn't report it. */
+    QMutexLocker locker(&m_mutex);
+    if (batch.isEmpty())
+        return m_nbEnqueued;
+    if (m_queuedRecords > 0 && m_queuedRecords + batch.size() > m_capacity && !m_stopping)
+        m_nbBlockedEnqueues++;
+    while (m_queuedRecords > 0 && m_queuedRecords + batch.size() > m_capacity && !m_stopping)
+        m_notFull.wait(&m_mutex);
+    m_queue.enqueue(batch);
+    m_queuedRecords += batch.size();
+    m_maxQueueDepth = qMax(m_maxQueueDepth,m_queuedRecords);
+    m_notEmpty.wakeOne();
+    if (waited)
+        m_waitedTickets.insert(m_nbEnqueued + 1);
+    return ++m_nbEnqueued;
+}
+
+void PersistenceWorker::flush()
+{
+    /*! Barrier : returns when every write enqueued before the call is committed or rolled back. */
+    QMutexLocker locker(&m_mutex);
+    while ((!m_queue.isEmpty() || m_inFlight > 0) && isRunning())
+        m_drained.wait(&m_mutex);
+}
+
+bool PersistenceWorker::flush(quint64 ticket, QString *error)
+{
+    /*! Barrier on one batch : returns when the batch of the ticket, and so every batch enqueued before it, is committed
+     * or rolled back. Returns at once if it already is, without waiting for the batches enqueued after it.
+     * For a batch enqueued as waited, returns false and sets error if it was rolled back or if the worker stopped before it ;
+     * the error is given only once. For the other batches, returns true. */
+    QMutexLocker locker(&m_mutex);
+    while (m_nbApplied < ticket && isRunning())
+        m_drained.wait(&m_mutex);
+    QString failure;
+    if (m_failedTickets.contains(ticket))
+        failure = m_failedTickets.take(ticket);
+    else if (m_nbApplied < ticket && m_waitedTickets.remove(ticket))
+        failure = "PersistenceWorker::flush : the worker stopped before the batch was applied";
+    if (failure.isEmpty())
+        return true;
+    if (error)
+        *error = failure;
+    return false;
+}
+
+void PersistenceWorker::stop()
+{
+    /*! Asks the worker to stop once the queue is drained, then waits for the end of the thread. */
+    {
+        QMutexLocker locker(&m_mutex);
+        m_stopping = true;
+        m_notEmpty.wakeAll();
+        m_notFull.wakeAll();
+    }
+    wait();
+}
+
+int PersistenceWorker::getQueueDepth() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_queuedRecords;
+}
+
+int PersistenceWorker::getMaxQueueDepth() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_maxQueueDepth;
+}
+
+quint64 PersistenceWorker::getNbCommits() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_nbCommits;
+}
+
+qint64 PersistenceWorker::getLastCommitLatency() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_lastCommitLatency;
+}
+
+qint64 PersistenceWorker::getAverageCommitLatency() const
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_nbCommits == 0)
+        return 0;
+    return m_totalCommitLatency / static_cast<qint64>(m_nbCommits);
+}
+
+quint64 PersistenceWorker::getNbFailedBatches() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_nbFailedBatches;
+}
+
+quint64 PersistenceWorker::getNbBlockedEnqueues() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_nbBlockedEnqueues;
+}
+
+void PersistenceWorker::run()
+{
+    /*! Body of the thread : waits for writes and applies all the batches that are in the queue in one transaction. */
+    {
+        // The connection has to be created in the thread that uses it
+        QSqlDatabase database = QSqlDatabase::addDatabase("QSQLITE",WRITERCONNECTION);
+        database.setDatabaseName(m_databaseName);
+        database.setConnectOptions("QSQLITE_BUSY_TIMEOUT=5000");
+        if (!database.open())
+            qWarning() << "PersistenceWorker::run : cannot open the database" << database.lastError().text();
+        // The GUI thread keeps reading while the worker commits ; a commit in WAL mode only syncs at the checkpoints
+        {
+            QSqlQuery pragma(database);
+            if (!pragma.exec("PRAGMA journal_mode=WAL;") || !pragma.next() || pragma.value(0).toString().compare("wal",Qt::CaseInsensitive) != 0)
+                qWarning() << "PersistenceWorker::run : the database can't use WAL" << pragma.lastError().text();
+            pragma.finish();
+            if (!pragma.exec("PRAGMA synchronous=NORMAL;"))
+                qWarning() << "PersistenceWorker::run : cannot set PRAGMA synchronous" << pragma.lastError().text();
+        }
+
+        QHash<const QString*,QSqlQuery*> statements; // The prepared statements of the worker, indexed by the address of their SQL text
+
+        forever {
+            QList<WriteBatch> batches;
+            {
+                QMutexLocker locker(&m_mutex);
+                while (m_queue.isEmpty() && !m_stopping)
+                    m_notEmpty.wait(&m_mutex);
+                if (m_queue.isEmpty()) // Stopping and nothing left to write
+                    break;
+                // We coalesce all the batches waiting in the queue
+                while (!m_queue.isEmpty())
+                    batches.append(m_queue.dequeue());
+                m_inFlight = m_queuedRecords;
+                m_queuedRecords = 0;
+                m_notFull.wakeAll();
+            }
+
+            QElapsedTimer timer;
+            timer.start();
+            const QStringList errors = applyBatches(database,statements,batches);
+            qint64 latency = timer.nsecsElapsed() / 1000;
+
+            QStringList reported; // The errors of the batches that nobody waits for
+            {
+                QMutexLocker locker(&m_mutex);
+                // The batches were dequeued in the order of their tickets
+                for (int i = 0; i < errors.size(); i++) {
+                    quint64 ticket = m_nbApplied + i + 1;
+                    bool waited = m_waitedTickets.remove(ticket);
+                    if (errors.at(i).isEmpty())
+                        continue;
+                    m_nbFailedBatches++;
+                    if (waited)
+                        m_failedTickets.insert(ticket,errors.at(i));
+                    else
+                        reported << errors.at(i);
+                }
+                m_inFlight = 0;
+                m_nbCommits++;
+                m_nbApplied += batches.size();
+                m_lastCommitLatency = latency;
+                m_totalCommitLatency += latency;
+                m_drained.wakeAll();
+            }
+            if (!reported.isEmpty())
+                emit batchesFailed(reported);
+        }
+
+        qDeleteAll(statements);
+        database.close();
+    }
+    QSqlDatabase::removeDatabase(WRITERCONNECTION);
+
+    // Nobody waits anymore for the writes of this worker
+    QMutexLocker locker(&m_mutex);
+    m_drained.wakeAll();
+}
+
+QStringList PersistenceWorker::applyBatches(QSqlDatabase &database, QHash<const QString*,QSqlQuery*> &statements, const QList<WriteBatch> &batches)
+{
+    /*! Applies the batches in one transaction. Each batch is applied inside a savepoint : if one of its writes fails,
+     * the batch is rolled back to the savepoint and the next batches are still applied.
+     * If the transaction itself can't be committed, every batch is rolled back.
+     * Returns the error of each batch, in the same order ; the error of a batch committed is empty. */
+    QStringList errors;
+    QSqlQuery savepoint(database);
+    if (!database.transaction()) {
+        QString error = QString("PersistenceWorker::applyBatches : cannot open a transaction : %1").arg(database.lastError().text());
+        for (int i = 0; i < batches.size(); i++)
+            errors << error;
+        return errors;
+    }
+    for (QList<WriteBatch>::const_iterator it = batches.cbegin(); it != batches.cend(); ++it) {
+        savepoint.exec("SAVEPOINT batch;");
+        QString error = applyRecords(database,statements,*it);
+        if (!error.isEmpty())
+            savepoint.exec("ROLLBACK TO batch;");
+        savepoint.exec("RELEASE batch;");
+        errors << error;
+    }
+    if (!database.commit()) {
+        QString error = QString("PersistenceWorker::applyBatches : commit failed : %1").arg(database.lastError().text());
+        database.rollback();
+        errors.clear();
+        for (int i = 0; i < batches.size(); i++)
+            errors << error;
+    }
+    return errors;
+}
+
+QString PersistenceWorker::applyRecords(QSqlDatabase &database, QHash<const QString*,QSqlQuery*> &statements, const WriteBatch &batch)
+{
+    /*! Executes the writes of a batch with the prepared statements of the worker, until one of them fails.
+     * Returns the error of the write that failed ; an empty string if they all succeeded. */
+    for (WriteBatch::const_iterator it = batch.cbegin(); it != batch.cend(); ++it) {
+        QSqlQuery * query = statements.value(it->getSql(),nullptr);
+        if (!query) {
+            query = new QSqlQuery(database);
+            if (!query->prepare(*it->getSql())) {
+                QString error = QString("PersistenceWorker::applyRecords : cannot prepare %1 : %2").arg(*it->getSql(),query->lastError().text());
+                delete query;
+                return error;
+            }
+            statements.insert(it->getSql(),query);
+        }
+        for (Bindings::const_iterator itB = it->getBindings().cbegin(); itB != it->getBindings().cend(); ++itB)
+            query->bindValue(itB->first,itB->second);
+        if (!query->exec())
+            return QString("PersistenceWorker::applyRecords : %1 : %2").arg(*it->getSql(),query->lastError().text());
+    }
+    return QString();
+}
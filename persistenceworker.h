@@ -0,0 +1,105 @@
+#ifndef PERSISTENCEWORKER_H
+#define PERSISTENCEWORKER_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QQueue>
+#include <QPair>
+#include <QVariant>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QElapsedTimer>
+#include <QStringList>
+#include <QSet>
+#include <QHash>
+#include <QDebug>
+
+typedef QList<QPair<QString,QVariant>> Bindings; /*!< The values bound to the placeholders of a statement, in the order of binding. */
+
+/*! \class WriteRecord
+ *  \brief An immutable write to apply on the database : a SQL statement and the values bound to it.
+ *
+ */
+class WriteRecord {
+public:
+    WriteRecord(const QString * sql,const Bindings& bindings) : m_sql(sql),m_bindings(bindings) {} /*!< The canonical constructor of a WriteRecord. The SQL text must live as long as the worker. */
+
+    // Getters
+    const QString * getSql() const {return m_sql;} /*!< Returns the SQL text of the statement. */
+    const Bindings& getBindings() const {return m_bindings;} /*!< Returns the values to bind before executing the statement. */
+
+private:
+    const QString * m_sql; /*!< The SQL text of the statement, a constant of the SQLiteManager. Its address is the key of the prepared statement in the worker. */
+    Bindings m_bindings; /*!< The values to bind to the placeholders of the statement. */
+};
+
+typedef QList<WriteRecord> WriteBatch; /*!< Writes that must be applied all together or not at all. */
+
+/*! \class PersistenceWorker
+ *  \brief [Inherited from QThread] Thread that applies the writes of the SQLiteManager in the background.
+ *
+ *  The writes are enqueued in a bounded queue by the GUI thread, batch by batch. The worker owns its own connection to the
+ *  database and drains the queue : all the batches waiting in the queue are applied in one transaction, each one inside
+ *  a savepoint, so a batch with a failing statement is rolled back alone. The caller of a batch that must not fail
+ *  silently waits for it with flush(ticket) ; the other failures are reported together with batchesFailed().
+ *  The database is in WAL mode with synchronous=NORMAL : the GUI thread reads while the worker commits.
+ */
+class PersistenceWorker : public QThread
+{
+    Q_OBJECT
+public:
+    PersistenceWorker(const QString& databaseName, int capacity=4096);
+    ~PersistenceWorker();
+
+    quint64 enqueue(const WriteRecord& record); /*!< Adds a write to the queue, as a batch of its own, and returns its ticket. Blocks while the queue is full. */
+    quint64 enqueue(const WriteBatch& batch, bool waited=false); /*!< Adds a batch of writes to the queue and returns its ticket ; they will be applied all together or not at all. */
+    void flush(); /*!< Blocks until all the writes enqueued are committed. */
+    bool flush(quint64 ticket, QString * error=nullptr); /*!< Blocks until the batch of this ticket and the ones before it are committed ; returns false if the batch of a waited ticket was rolled back. */
+    void stop(); /*!< Applies the remaining writes and stops the thread. */
+
+    // Counters
+    int getQueueDepth() const; /*!< Returns the number of writes waiting in the queue. */
+    int getMaxQueueDepth() const; /*!< Returns the highest number of writes that waited in the queue. */
+    quint64 getNbCommits() const; /*!< Returns the number of transactions committed by the worker. */
+    qint64 getLastCommitLatency() const; /*!< Returns the time in microseconds spent in the last transaction. */
+    qint64 getAverageCommitLatency() const; /*!< Returns the average time in microseconds spent in a transaction. */
+    quint64 getNbFailedBatches() const; /*!< Returns the number of batches rolled back because one of their writes failed. */
+    quint64 getNbBlockedEnqueues() const; /*!< Returns the number of calls to enqueue() that waited for room in the queue. */
+
+signals:
+    void batchesFailed(const QStringList& errors); /*!< Emitted from the thread of the worker once per transaction, with the errors of the batches rolled back that nobody waits for. Connect it with a queued connection. */
+
+protected:
+    void run() override;
+
+private:
+    const QString m_databaseName; /*!< The file of the database. */
+    const int m_capacity; /*!< The number of writes above which enqueue() blocks : the GUI thread is slowed down to the pace of the disk instead of queueing without bound. */
+
+    mutable QMutex m_mutex; /*!< Protects the queue and the counters. */
+    QWaitCondition m_notEmpty; /*!< Signaled when writes are enqueued or when the worker has to stop. */
+    QWaitCondition m_notFull; /*!< Signaled when the worker takes writes from the queue. */
+    QWaitCondition m_drained; /*!< Signaled each time the writes taken from the queue are committed. */
+    QQueue<WriteBatch> m_queue; /*!< The batches waiting to be applied. */
+    int m_queuedRecords; /*!< Number of writes in the batches of the queue. */
+    int m_inFlight; /*!< Number of writes taken from the queue and not committed yet. */
+    bool m_stopping; /*!< True when the worker has been asked to stop. */
+    quint64 m_nbEnqueued; /*!< Number of batches enqueued ; the ticket of a batch is the value reached when it is enqueued. */
+    quint64 m_nbApplied; /*!< Number of batches committed or rolled back, in the order of their tickets. */
+    QSet<quint64> m_waitedTickets; /*!< Tickets of the batches whose caller waits with flush(ticket) ; their failure isn't signaled. */
+    QHash<quint64,QString> m_failedTickets; /*!< Errors of the waited batches rolled back, until flush(ticket) reads them. */
+
+    int m_maxQueueDepth; /*!< Highest size reached by the queue. */
+    quint64 m_nbCommits; /*!< Number of transactions committed. */
+    qint64 m_lastCommitLatency; /*!< Duration in microseconds of the last transaction. */
+    qint64 m_totalCommitLatency; /*!< Sum of the durations in microseconds of all the transactions. */
+    quint64 m_nbFailedBatches; /*!< Number of batches rolled back. */
+    quint64 m_nbBlockedEnqueues; /*!< Number of calls to enqueue() that had to wait for room in the queue. */
+
+    QStringList applyBatches(QSqlDatabase& database, QHash<const QString*,QSqlQuery*>& statements, const QList<WriteBatch>& batches); /*!< Applies the batches in one transaction and returns the error of each one ; empty if it was committed. */
+    QString applyRecords(QSqlDatabase& database, QHash<const QString*,QSqlQuery*>& statements, const WriteBatch& batch); /*!< Executes the writes of a batch ; returns the error of the first one that fails. */
+};
+
+#endif // PERSISTENCEWORKER_H
@@ -41,32 +41,22 @@ void Relation::createCouple(const Note *first, const Note *sec, const QString &l
     }
 }
 
+PairNotes Relation::coupleKey(const Note *noteAsc, const Note *noteDesc) const
+{
+    /*! Returns the key of the couple in the index. For a relation that isn't oriented, the key is
+     * the same whatever the order of the notes, so one lookup finds the couple in both orders. */
+    if (!isOriented() && std::less<const Note*>()(noteDesc,noteAsc))
+        return make_pair(noteDesc,noteAsc);
+    return make_pair(noteAsc,noteDesc);
+}
+
 Couple *Relation::getCouple(const Note *noteAsc, const Note *noteDesc)
 {
     /*! Returns the couple if it exists in the relation ; otherwise returns nullptr */
     if (noteAsc == nullptr || noteDesc == nullptr)
         return nullptr;
 
-    Couple coupleToFind(noteAsc,noteDesc);
-
-    Couple * currentCouple = nullptr;
-
-    if (!isOriented()){ // we have to check for the other order
-        Couple anotherCoupleToFind(noteDesc,noteAsc);
-        for(iterator it = begin(); it != end(); it++){
-            currentCouple = (*it);
-            if(*currentCouple == coupleToFind || *currentCouple == anotherCoupleToFind)
-                return currentCouple;
-        }
-    }
-    else {
-        for(iterator it = begin(); it != end(); it++){
-            currentCouple = (*it);
-            if(*currentCouple == coupleToFind)
-                return currentCouple;
-        }
-    }
-    return nullptr;
+    return m_index.value(coupleKey(noteAsc,noteDesc),nullptr);
 }
 
 const Couple *Relation::getCouple(const Note *noteAsc, const Note *noteDesc) const
@@ -75,44 +65,74 @@ const Couple *Relation::getCouple(const Note *noteAsc, const Note *noteDesc) con
     if (noteAsc == nullptr || noteDesc == nullptr)
         return nullptr;
 
-    Couple coupleToFind(noteAsc,noteDesc);
+    return m_index.value(coupleKey(noteAsc,noteDesc),nullptr);
+}
+
+void Relation::setOrientation(bool orientation)
+{
+    /*! Changes the orientation of the relation. The keys of the index depend on it, so the index is rebuilt. */
+    if (orientation == m_isOriented)
+        return;
+    m_isOriented = orientation;
+    m_index.clear();
+    for (QSet<Couple*>::const_iterator it = m_couples.cbegin(); it != m_couples.cend(); ++it)
+        m_index.insert(coupleKey((*it)->getAsc(),(*it)->getDesc()),*it);
+}
 
-    const Couple * currentCouple = nullptr;
+Relation &Relation::operator<<(Couple *toAddCouple)
+{
+    /*! Adds the couple in the relation, in the index and in the adjacency lists of its notes. */
+    m_couples << toAddCouple;
+    m_index.insert(coupleKey(toAddCouple->getAsc(),toAddCouple->getDesc()),toAddCouple);
+    m_outgoing[toAddCouple->getAsc()].append(toAddCouple);
+    m_incoming[toAddCouple->getDesc()].append(toAddCouple);
+    emit NotesManager::getInstance().coupleAdded(this,toAddCouple);
+    return *this;
+}
 
-    if (!isOriented()){ // we have to check for the other order
-        Couple anotherCoupleToFind(noteDesc,noteAsc);
-        for(const_iterator it = cbegin(); it != cend(); it++){
-            currentCouple = (*it);
-            if(*currentCouple == coupleToFind || *currentCouple == anotherCoupleToFind)
-                return currentCouple;
-        }
+Relation::iterator Relation::erase(const Relation::iterator &it)
+{
+    /*! Erases the couple pointed by the iterator from the relation, from the index and from the adjacency lists. */
+    Couple * coupleToErase = *it.m_iterator;
+    emit NotesManager::getInstance().coupleRemoved(this,coupleToErase);
+    CoupleIndex::iterator itI = m_index.find(coupleKey(coupleToErase->getAsc(),coupleToErase->getDesc()));
+    if (itI != m_index.end() && itI.value() == coupleToErase)
+        m_index.erase(itI);
+
+    Adjacency::iterator itA = m_outgoing.find(coupleToErase->getAsc());
+    if (itA != m_outgoing.end()) {
+        itA.value().removeOne(coupleToErase);
+        if (itA.value().isEmpty())
+            m_outgoing.erase(itA);
     }
-    else {
-        for(const_iterator it = cbegin(); it != cend(); it++){
-            currentCouple = (*it);
-            if(*currentCouple == coupleToFind)
-                return currentCouple;
-        }
+    itA = m_incoming.find(coupleToErase->getDesc());
+    if (itA != m_incoming.end()) {
+        itA.value().removeOne(coupleToErase);
+        if (itA.value().isEmpty())
+            m_incoming.erase(itA);
     }
-    return nullptr;
+    return iterator(m_couples.erase(it.m_iterator));
 }
 
-
 Relation::iterator Relation::deleteCouple(Couple *coupleToDel)
 {
     /*! Deletes the couple both in the NotesManager and via the dataManager */
-    iterator it=begin();
-    while(it != end()){
-        if ((*it) == coupleToDel) {
-            NotesManager::getInstance().getDataManager().deleteCouple(coupleToDel,getName());
-            it = erase(it);
-            return it;
-        }
-        else {
-            it++;
-        }
-   }
-   throw NoteException("Relation::deleteCouple : couple not found");
+    QSet<Couple*>::iterator it = m_couples.find(coupleToDel);
+    if (it == m_couples.end())
+        throw NoteException("Relation::deleteCouple : couple not found");
+
+    NotesManager::getInstance().getDataManager().deleteCouple(coupleToDel,getName());
+    return erase(iterator(it));
+}
+
+Relation::iterator Relation::removeCouple(Couple *coupleToRemove)
+{
+    /*! Removes the couple from the relation, the index and the adjacency lists, once its deletion was written via the dataManager */
+    QSet<Couple*>::iterator it = m_couples.find(coupleToRemove);
+    if (it == m_couples.end())
+        throw NoteException("Relation::removeCouple : couple not found");
+
+    return erase(iterator(it));
 }
 
 
@@ -7,10 +7,14 @@
 #include <vector>
 #include <set>
 #include <QString>
+#include <QHash>
 
 using namespace std;
 
 typedef pair<const Note*,const Note*> PairNotes;
+class Couple;
+typedef QHash<PairNotes,Couple*> CoupleIndex; /*!< Index of the couples of a relation on their pair of notes. */
+typedef QHash<const Note*,QList<Couple*>> Adjacency; /*!< Couples of a relation grouped by one of their notes. */
 
 /*! \class Couple
  * \brief A pair of two notes that can be labelled. Each Couple lives in a specific Relation and can be seen as an oriented couple is the associated Relation does.
@@ -60,19 +64,22 @@ public:
     const QString& getName() const { return m_name;} /*!< Returns the name of the relation.*/
     const QString& getDescription() const { return m_description;} /*!< Returns the description of the relation.*/
     bool isOriented() const { return m_isOriented;} /*!< Returns true if the relation isOriented.*/
+    int getNbCouples() const { return m_couples.size();} /*!< Returns the number of couples in the relation.*/
 
 
     void createCouple(const Note * first,const Note* sec,const QString& l="",bool saveInDB = true);
     Couple * getCouple(const Note * noteAsc,const Note * noteDesc); /*!< Returns the couple.*/
     const Couple * getCouple(const Note * noteAsc,const Note * noteDesc) const ; /*!< Returns the couple.*/
+    QList<Couple*> getOutgoingCouples(const Note * noteAsc) const { return m_outgoing.value(noteAsc);} /*!< Returns the couples whose ascendant note is noteAsc.*/
+    QList<Couple*> getIncomingCouples(const Note * noteDesc) const { return m_incoming.value(noteDesc);} /*!< Returns the couples whose descendant note is noteDesc.*/
 
 
     // Setters
     void setDescription(const QString& description) {m_description = description;} /*!< Setter for the name of the relation.*/
-    void setOrientation(bool orientation) {m_isOriented = orientation;}  /*!< Setter for the orientation of the relation.*/
+    void setOrientation(bool orientation);  /*!< Setter for the orientation of the relation.*/
 
 
-    Relation& operator<<(Couple * toAddCouple) { m_couples<<toAddCouple; return *this;} /*!< A way to add couple in the relation.*/
+    Relation& operator<<(Couple * toAddCouple); /*!< A way to add couple in the relation.*/
 
     void debugPrintCouples() const;
 
@@ -80,9 +87,10 @@ public:
     typedef customIterator::iterator<Couple, QSet<Couple*>,Relation> iterator;
     iterator begin() { return iterator(m_couples.begin()); } /*!< Returns a iterator of versions set on the most recent version. */
     iterator end() { return iterator(m_couples.end()); } /*!< Returns a iterator of versions set on the most recent version. */
-    iterator erase(const iterator& it) { return iterator(m_couples.erase(it.m_iterator)); } /*!< Erase a couple based on an iterator pointing on it. */
+    iterator erase(const iterator& it); /*!< Erase a couple based on an iterator pointing on it. */
 
     iterator deleteCouple(Couple * coupleToDel);
+    iterator removeCouple(Couple * coupleToRemove); /*!< Removes a couple from the relation only, without changing the persistent data. */
 
     /** Const Iterator on the couples of the relation. Adapted from QSet<Couple*>::const_iterator via our custom iterators. */
     typedef customIterator::const_iterator<Couple, QSet<Couple*>,Relation> const_iterator;
@@ -95,6 +103,11 @@ private:
     QString m_description; /*!< Description of the relation. */
     bool m_isOriented; /*!< Indicates if the relation is oriented or not. */
     QSet<Couple*> m_couples; /*!< Couples' set. */
+    CoupleIndex m_index; /*!< The couples indexed by their pair of notes, kept in sync with m_couples. */
+    Adjacency m_outgoing; /*!< The couples grouped by their ascendant note, kept in sync with m_couples. */
+    Adjacency m_incoming; /*!< The couples grouped by their descendant note, kept in sync with m_couples. */
+
+    PairNotes coupleKey(const Note * noteAsc,const Note * noteDesc) const; /*!< Returns the key of a couple in m_index.*/
 };
 
 #endif // RELATION_H
@@ -0,0 +1,151 @@
+#include "relationmodel.h"
+
+RelationModel::RelationModel(QObject *parent) : QAbstractTableModel(parent), m_relation(nullptr), m_emptyRows(false)
+{
+    /*! Builds an empty model, following the changes of the couples of the NotesManager. */
+    NotesManager& manager = NotesManager::getInstance();
+    connect(&manager, &NotesManager::coupleAdded, this, &RelationModel::coupleAdded);
+    connect(&manager, &NotesManager::coupleRemoved, this, &RelationModel::coupleRemoved);
+}
+
+void RelationModel::setRelation(const Relation *relation)
+{
+    /*! Shows the couples of another relation. Only the pointers on the couples are copied. */
+    beginResetModel();
+    m_relation = relation;
+    m_couples.clear();
+    m_rows.clear();
+    if (relation != nullptr) {
+        m_couples.reserve(relation->getNbCouples());
+        m_rows.reserve(relation->getNbCouples());
+        for (Relation::const_iterator itC = relation->cbegin(); itC != relation->cend(); itC++) {
+            m_rows.insert(*itC,m_couples.size());
+            m_couples.append(*itC);
+        }
+    }
+    endResetModel();
+}
+
+int RelationModel::rowCount(const QModelIndex &parent) const
+{
+    /*! Returns the number of couples of the relation */
+    if (parent.isValid())
+        return 0;
+    return m_couples.size();
+}
+
+int RelationModel::columnCount(const QModelIndex &parent) const
+{
+    /*! Returns the number of columns : the label and the two notes */
+    if (parent.isValid())
+        return 0;
+    return 3;
+}
+
+QVariant RelationModel::data(const QModelIndex &index, int role) const
+{
+    /*! Reads the cell straight from the couple : its label, or the ID of one of its notes. With Qt::UserRole, the handle of the note. */
+    if (!index.isValid() || index.row() >= m_couples.size())
+        return QVariant();
+    const Couple * couple = m_couples.at(index.row());
+    if (couple == nullptr) // Row of a couple removed, not freed yet
+        return QVariant();
+
+    if (role == Qt::DisplayRole)
+    {
+        switch (index.column())
+        {
+        case 0:
+            return couple->getLabel();
+        case 1:
+            return couple->getIdAsc();
+        case 2:
+            return couple->getIdDesc();
+        }
+    }
+    else if (role == Qt::UserRole)
+    {
+        // The cell of the label holds no note
+        if (index.column() == 1)
+            return couple->getAsc()->getHandle();
+        if (index.column() == 2)
+            return couple->getDesc()->getHandle();
+    }
+    return QVariant();
+}
+
+QVariant RelationModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    /*! Titles of the columns */
+    if (role != Qt::DisplayRole || orientation != Qt::Horizontal)
+        return QVariant();
+    switch (section)
+    {
+    case 0:
+        return QString("Label");
+    case 1:
+        return QString("Note 1");
+    case 2:
+        return QString("Note 2");
+    }
+    return QVariant();
+}
+
+void RelationModel::coupleAdded(Relation *relation, Couple *couple)
+{
+    /*! Appends the row of the couple if it belongs to the relation shown */
+    if (relation != m_relation)
+        return;
+    int row = m_couples.size();
+    beginInsertRows(QModelIndex(), row, row);
+    m_rows.insert(couple,row);
+    m_couples.append(couple);
+    endInsertRows();
+}
+
+void RelationModel::coupleRemoved(Relation *relation, Couple *couple)
+{
+    /*! Empties the row of the couple, found through the index of the rows : the couple may be deleted after the signal.
+     * The rows don't move yet, so the index stays right for the next couples removed ; the empty rows are removed
+     * together by removeEmptyRows() once the control is back to the event loop. */
+    if (relation != m_relation)
+        return;
+    QHash<const Couple*,int>::iterator it = m_rows.find(couple);
+    if (it == m_rows.end())
+        return;
+    int row = it.value();
+    m_rows.erase(it);
+    m_couples[row] = nullptr;
+    emit dataChanged(index(row,0),index(row,2));
+    if (!m_emptyRows) {
+        m_emptyRows = true;
+        QTimer::singleShot(0, this, &RelationModel::removeEmptyRows);
+    }
+}
+
+void RelationModel::removeEmptyRows()
+{
+    /*! Removes the rows of the couples removed, one range of contiguous rows at a time, between beginRemoveRows()
+     * and endRemoveRows() : the proxy and the views move the persistent indexes and the selection of the next rows up with it.
+     * The ranges are removed from the last one, so the rows of the others don't move meanwhile ; the index of the rows
+     * is then updated once, from the first row removed. */
+    m_emptyRows = false;
+    int firstRemoved = m_couples.size();
+    int last = m_couples.size() - 1;
+    while (last >= 0) {
+        if (m_couples.at(last) != nullptr) {
+            last--;
+            continue;
+        }
+        int first = last;
+        while (first > 0 && m_couples.at(first - 1) == nullptr)
+            first--;
+        beginRemoveRows(QModelIndex(), first, last);
+        m_couples.remove(first, last - first + 1);
+        endRemoveRows();
+        firstRemoved = first;
+        last = first - 1;
+    }
+    for (int row = firstRemoved; row < m_couples.size(); row++)
+        m_rows[m_couples.at(row)] = row;
+}
@@ -0,0 +1,46 @@
+#ifndef RELATIONMODEL_H
+#define RELATIONMODEL_H
+
+#include <QAbstractTableModel>
+#include <QVector>
+#include <QHash>
+#include <QTimer>
+#include "notesmanager.h"
+
+/**
+ * \class RelationModel
+ * \brief [Inherited from QAbstractTableModel] Model of the couples of one relation : label, ascendant and descendant
+ *
+ * The model only keeps pointers on the couples of the relation, in no particular order : the view sorts them through a proxy.
+ * It follows the couples added and removed with the signals of the NotesManager : a couple added is appended,
+ * the row of a couple removed is emptied at once, found through the index of the rows. The empty rows are removed
+ * together from the event loop, one range of contiguous rows at a time, and the next rows move up, as announced to the views.
+ * The cells of the notes give the handle of their note with the role Qt::UserRole.
+ */
+class RelationModel : public QAbstractTableModel
+{
+    Q_OBJECT
+public:
+    RelationModel(QObject *parent = nullptr);
+
+    void setRelation(const Relation * relation);
+    const Relation * getRelation() const {return m_relation;} /*!< Returns the relation shown by the model */
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role) const override;
+
+private slots:
+    void coupleAdded(Relation * relation, Couple * couple);
+    void coupleRemoved(Relation * relation, Couple * couple);
+    void removeEmptyRows();
+
+private:
+    const Relation * m_relation; /*!< The relation shown ; nullptr if there isn't */
+    QVector<const Couple*> m_couples; /*!< The couples of the relation, one per row ; nullptr for the row of a couple removed and not freed yet */
+    QHash<const Couple*,int> m_rows; /*!< The row of each couple of m_couples */
+    bool m_emptyRows; /*!< True when removeEmptyRows() is planned */
+};
+
+#endif // RELATIONMODEL_H
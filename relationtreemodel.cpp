@@ -0,0 +1,312 @@
+#include "relationtreemodel.h"
+
+const int COUPLESPAGE = 50; // Number of couples given to the view by fetchMore()
+
+RelationTreeModel::RelationTreeModel(QObject *parent) : QAbstractItemModel(parent), m_note(nullptr),
+    m_root(new RelationTreeNode(RelationTreeNode::RootNode,nullptr,nullptr))
+{
+    /*! Builds an empty tree, following the changes of the couples of the NotesManager. */
+    NotesManager& manager = NotesManager::getInstance();
+    connect(&manager, &NotesManager::relationCreated, this, &RelationTreeModel::relationCreated);
+    connect(&manager, &NotesManager::coupleAdded, this, &RelationTreeModel::coupleAdded);
+    connect(&manager, &NotesManager::coupleRemoved, this, &RelationTreeModel::coupleRemoved);
+}
+
+RelationTreeModel::~RelationTreeModel()
+{
+    /*! Deletes the nodes of the tree. */
+    delete m_root;
+}
+
+void RelationTreeModel::setNote(const Note *note)
+{
+    /*! Shows the relations of another note. Only the nodes of the relations are built ; their children are built on demand. */
+    beginResetModel();
+    qDeleteAll(m_root->children);
+    m_root->children.clear();
+    m_relationNodes.clear();
+    m_coupleNodes.clear();
+    m_note = note;
+    if (note != nullptr)
+    {
+        NotesManager& manager = NotesManager::getInstance();
+        for (NotesManager::const_iteratorRelation itR = manager.cbeginRelation(); itR != manager.cendRelation(); itR++)
+        {
+            RelationTreeNode * node = new RelationTreeNode(RelationTreeNode::RelationNode,m_root,*itR);
+            m_root->children.append(node);
+            m_relationNodes.insert(*itR,node);
+        }
+    }
+    m_root->fetched = true;
+    endResetModel();
+}
+
+RelationTreeNode *RelationTreeModel::nodeOf(const QModelIndex &index) const
+{
+    /*! Returns the node of the index ; the root for an invalid index. */
+    if (!index.isValid())
+        return m_root;
+    return static_cast<RelationTreeNode*>(index.internalPointer());
+}
+
+QModelIndex RelationTreeModel::indexOf(RelationTreeNode *node) const
+{
+    /*! Returns the index of the first column of the node. Its siblings are only searched for the relations and the directions, which are few. */
+    if (node == m_root || node->parent == nullptr)
+        return QModelIndex();
+    return createIndex(node->parent->children.indexOf(node),0,node);
+}
+
+QModelIndex RelationTreeModel::index(int row, int column, const QModelIndex &parent) const
+{
+    /*! Returns the index of the child of parent at this row */
+    RelationTreeNode * parentNode = nodeOf(parent);
+    if (row < 0 || row >= parentNode->children.size() || column < 0 || column >= 2)
+        return QModelIndex();
+    return createIndex(row,column,parentNode->children.at(row));
+}
+
+QModelIndex RelationTreeModel::parent(const QModelIndex &index) const
+{
+    /*! Returns the index of the parent of the node */
+    if (!index.isValid())
+        return QModelIndex();
+    return indexOf(nodeOf(index)->parent);
+}
+
+int RelationTreeModel::rowCount(const QModelIndex &parent) const
+{
+    /*! Returns the number of children built so far */
+    if (parent.column() > 0)
+        return 0;
+    return nodeOf(parent)->children.size();
+}
+
+int RelationTreeModel::columnCount(const QModelIndex &parent) const
+{
+    /*! Two columns : the name and the description (or the label of the couple) */
+    Q_UNUSED(parent);
+    return 2;
+}
+
+bool RelationTreeModel::hasChildren(const QModelIndex &parent) const
+{
+    /*! Tells if the node has children without building them : only the size of the adjacency lists is read. */
+    const RelationTreeNode * node = nodeOf(parent);
+    if (node->fetched)
+        return !node->children.isEmpty() || !node->pending.isEmpty();
+    switch (node->type)
+    {
+    case RelationTreeNode::RelationNode:
+        return node->relation->isOriented() || !node->relation->getOutgoingCouples(m_note).isEmpty()
+                || !node->relation->getIncomingCouples(m_note).isEmpty();
+    case RelationTreeNode::AscendantsNode:
+        return !node->relation->getIncomingCouples(m_note).isEmpty();
+    case RelationTreeNode::DescendantsNode:
+        return !node->relation->getOutgoingCouples(m_note).isEmpty();
+    default:
+        return false;
+    }
+}
+
+bool RelationTreeModel::canFetchMore(const QModelIndex &parent) const
+{
+    /*! The children of a node are listed when it is expanded, then its couples are built page by page */
+    const RelationTreeNode * node = nodeOf(parent);
+    return node->type != RelationTreeNode::CoupleNode && (!node->fetched || !node->pending.isEmpty());
+}
+
+void RelationTreeModel::fetchMore(const QModelIndex &parent)
+{
+    /*! Builds the two directions of an oriented relation, or the next page of the couples of the node.
+     * The couples are listed the first time ; the view asks for the next pages when it scrolls to the last one. */
+    RelationTreeNode * node = nodeOf(parent);
+    if (node->type == RelationTreeNode::CoupleNode)
+        return;
+    if (!node->fetched)
+    {
+        node->fetched = true;
+        if (node->type == RelationTreeNode::RelationNode && node->relation->isOriented())
+        {
+            beginInsertRows(parent,0,1);
+            node->children.append(new RelationTreeNode(RelationTreeNode::AscendantsNode,node,node->relation));
+            node->children.append(new RelationTreeNode(RelationTreeNode::DescendantsNode,node,node->relation));
+            endInsertRows();
+            return;
+        }
+        node->pending = listCouples(node);
+    }
+    int nbRows = qMin(COUPLESPAGE,node->pending.size());
+    if (nbRows <= 0)
+        return;
+    int row = node->children.size();
+    beginInsertRows(parent,row,row + nbRows - 1);
+    for (int i = 0; i < nbRows; i++)
+    {
+        CoupleOfNote couple = node->pending.takeFirst();
+        node->children.append(newCoupleNode(node,couple.first,couple.second));
+    }
+    endInsertRows();
+}
+
+RelationTreeNode *RelationTreeModel::newCoupleNode(RelationTreeNode *parent, const Couple *couple, const Note *other)
+{
+    /*! Builds the node of a couple, showing the other note. The node isn't added to the children of parent. */
+    RelationTreeNode * node = new RelationTreeNode(RelationTreeNode::CoupleNode,parent,parent->relation,couple,other);
+    node->fetched = true;
+    m_coupleNodes.insert(couple,node);
+    return node;
+}
+
+QList<CoupleOfNote> RelationTreeModel::listCouples(const RelationTreeNode *node) const
+{
+    /*! Lists the couples of the note under the node, taken from the adjacency lists, without building their nodes.
+     * A couple of the note with itself is only listed once if the relation isn't oriented. */
+    QList<CoupleOfNote> couples;
+    const Relation * relation = node->relation;
+    if (node->type == RelationTreeNode::RelationNode || node->type == RelationTreeNode::DescendantsNode)
+    {
+        const QList<Couple*> outgoing = relation->getOutgoingCouples(m_note);
+        for (QList<Couple*>::const_iterator itC = outgoing.cbegin(); itC != outgoing.cend(); itC++)
+            couples.append(qMakePair<const Couple*,const Note*>(*itC,(*itC)->getDesc()));
+    }
+    if (node->type == RelationTreeNode::RelationNode || node->type == RelationTreeNode::AscendantsNode)
+    {
+        const QList<Couple*> incoming = relation->getIncomingCouples(m_note);
+        for (QList<Couple*>::const_iterator itC = incoming.cbegin(); itC != incoming.cend(); itC++)
+            if (relation->isOriented() || (*itC)->getAsc() != m_note)
+                couples.append(qMakePair<const Couple*,const Note*>(*itC,(*itC)->getAsc()));
+    }
+    return couples;
+}
+
+QVariant RelationTreeModel::data(const QModelIndex &index, int role) const
+{
+    /*! Name and description of a relation, name of a direction, or ID of the other note and label of a couple.
+     * With Qt::UserRole, the handle of the other note of a couple. */
+    if (!index.isValid())
+        return QVariant();
+    const RelationTreeNode * node = nodeOf(index);
+
+    if (role == Qt::UserRole)
+    {
+        if (node->type == RelationTreeNode::CoupleNode)
+            return node->other->getHandle();
+        return QVariant();
+    }
+    if (role != Qt::DisplayRole)
+        return QVariant();
+
+    switch (node->type)
+    {
+    case RelationTreeNode::RelationNode:
+        return index.column() == 0 ? node->relation->getName() : node->relation->getDescription();
+    case RelationTreeNode::AscendantsNode:
+        return index.column() == 0 ? QString("Ascendants") : QVariant();
+    case RelationTreeNode::DescendantsNode:
+        return index.column() == 0 ? QString("Descendants") : QVariant();
+    case RelationTreeNode::CoupleNode:
+        return index.column() == 0 ? node->other->getId() : node->couple->getLabel();
+    default:
+        return QVariant();
+    }
+}
+
+QVariant RelationTreeModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    /*! Titles of the columns */
+    if (role != Qt::DisplayRole || orientation != Qt::Horizontal)
+        return QVariant();
+    return section == 0 ? QString("Nom") : QString("Description");
+}
+
+void RelationTreeModel::appendCouple(RelationTreeNode *parent, const Couple *couple, const Note *other)
+{
+    /*! Adds the couple at the end of the children of parent, if they are all built ; otherwise it will be built with them. */
+    if (!parent->fetched)
+    {
+        // The view only asks hasChildren() again when the layout changes : it may have to show the expand arrow now
+        QList<QPersistentModelIndex> parents;
+        parents << indexOf(parent);
+        emit layoutAboutToBeChanged(parents);
+        emit layoutChanged(parents);
+        return;
+    }
+    if (!parent->pending.isEmpty())
+    {
+        parent->pending.append(qMakePair(couple,other));
+        return;
+    }
+    int row = parent->children.size();
+    beginInsertRows(indexOf(parent),row,row);
+    parent->children.append(newCoupleNode(parent,couple,other));
+    endInsertRows();
+}
+
+void RelationTreeModel::relationCreated(Relation *relation)
+{
+    /*! Adds the node of a new relation, at its place in the order of the names */
+    if (m_note == nullptr)
+        return;
+    int row = 0;
+    while (row < m_root->children.size() && m_root->children.at(row)->relation->getName() < relation->getName())
+        row++;
+    beginInsertRows(QModelIndex(),row,row);
+    RelationTreeNode * node = new RelationTreeNode(RelationTreeNode::RelationNode,m_root,relation);
+    m_root->children.insert(row,node);
+    m_relationNodes.insert(relation,node);
+    endInsertRows();
+}
+
+void RelationTreeModel::coupleAdded(Relation *relation, Couple *couple)
+{
+    /*! Adds the couple under its relation if it involves the note shown */
+    RelationTreeNode * relationNode = m_relationNodes.value(relation,nullptr);
+    if (m_note == nullptr || relationNode == nullptr)
+        return;
+    if (relation->isOriented())
+    {
+        // The directions are the children of the relation : the ascendants then the descendants
+        if (!relationNode->fetched)
+            return;
+        if (couple->getAsc() == m_note)
+            appendCouple(relationNode->children.at(1),couple,couple->getDesc());
+        if (couple->getDesc() == m_note)
+            appendCouple(relationNode->children.at(0),couple,couple->getAsc());
+    }
+    else if (couple->getAsc() == m_note)
+        appendCouple(relationNode,couple,couple->getDesc());
+    else if (couple->getDesc() == m_note)
+        appendCouple(relationNode,couple,couple->getAsc());
+}
+
+void RelationTreeModel::coupleRemoved(Relation *relation, Couple *couple)
+{
+    /*! Removes the nodes of the couple built so far, and the couple from the ones listed and not built yet */
+    RelationTreeNode * relationNode = m_relationNodes.value(relation,nullptr);
+    if (relationNode != nullptr)
+    {
+        relationNode->pending.removeAll(qMakePair<const Couple*,const Note*>(couple,couple->getAsc()));
+        relationNode->pending.removeAll(qMakePair<const Couple*,const Note*>(couple,couple->getDesc()));
+        // The directions of an oriented relation list its couples too
+        if (relation->isOriented())
+        {
+            for (QVector<RelationTreeNode*>::const_iterator it = relationNode->children.cbegin(); it != relationNode->children.cend(); it++)
+            {
+                (*it)->pending.removeAll(qMakePair<const Couple*,const Note*>(couple,couple->getAsc()));
+                (*it)->pending.removeAll(qMakePair<const Couple*,const Note*>(couple,couple->getDesc()));
+            }
+        }
+    }
+    const QList<RelationTreeNode*> nodes = m_coupleNodes.values(couple);
+    m_coupleNodes.remove(couple);
+    for (QList<RelationTreeNode*>::const_iterator it = nodes.cbegin(); it != nodes.cend(); it++)
+    {
+        RelationTreeNode * parentNode = (*it)->parent;
+        int row = parentNode->children.indexOf(*it);
+        beginRemoveRows(indexOf(parentNode),row,row);
+        parentNode->children.remove(row);
+        delete *it;
+        endRemoveRows();
+    }
+}
@@ -0,0 +1,82 @@
+#ifndef RELATIONTREEMODEL_H
+#define RELATIONTREEMODEL_H
+
+#include <QAbstractItemModel>
+#include <QVector>
+#include <QHash>
+#include <QMultiHash>
+#include "notesmanager.h"
+
+typedef QPair<const Couple*,const Note*> CoupleOfNote; /*!< A couple of the note shown, with its other note. */
+
+/*! \struct RelationTreeNode
+ *  \brief A node of the tree of the relations : a relation, the group of the ascendants or of the descendants, or a couple.
+ *
+ *  A node owns its children. They are only built when the node is expanded, and the couples page by page.
+ */
+struct RelationTreeNode {
+    /*! The kinds of nodes */
+    enum NodeType {RootNode, RelationNode, AscendantsNode, DescendantsNode, CoupleNode};
+
+    RelationTreeNode(NodeType t, RelationTreeNode * p, const Relation * r, const Couple * c = nullptr, const Note * o = nullptr)
+        : type(t), parent(p), relation(r), couple(c), other(o), fetched(false) {} /*!< Constructor of a node without children */
+    ~RelationTreeNode() { qDeleteAll(children); } /*!< Destructor : deletes the children */
+
+    NodeType type; /*!< The kind of the node */
+    RelationTreeNode * parent; /*!< The parent of the node ; nullptr for the root */
+    const Relation * relation; /*!< The relation the node belongs to */
+    const Couple * couple; /*!< For a CoupleNode, the couple */
+    const Note * other; /*!< For a CoupleNode, the note of the couple that isn't the current note */
+    QVector<RelationTreeNode*> children; /*!< The children built so far */
+    QList<CoupleOfNote> pending; /*!< The couples listed and not built yet ; the view fetches them page by page */
+    bool fetched; /*!< True once the children are listed */
+};
+
+/**
+ * \class RelationTreeModel
+ * \brief [Inherited from QAbstractItemModel] Tree of the relations of a note : relation, then direction, then the other note of each couple
+ *
+ * Only the relations are built when the note changes. The directions and the couples are built with fetchMore(),
+ * when the view expands their parent, from the adjacency lists of the relation ; the couples are given page by page.
+ * The relations created and the couples added and removed are followed with the signals of the NotesManager, in the nodes already built.
+ * The cells of the couples give the handle of the other note with the role Qt::UserRole.
+ */
+class RelationTreeModel : public QAbstractItemModel
+{
+    Q_OBJECT
+public:
+    RelationTreeModel(QObject *parent = nullptr);
+    ~RelationTreeModel();
+
+    void setNote(const Note * note);
+    const Note * getNote() const {return m_note;} /*!< Returns the note whose relations are shown */
+
+    QModelIndex index(int row, int column, const QModelIndex &parent = QModelIndex()) const override;
+    QModelIndex parent(const QModelIndex &index) const override;
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role) const override;
+    bool hasChildren(const QModelIndex &parent = QModelIndex()) const override;
+    bool canFetchMore(const QModelIndex &parent) const override;
+    void fetchMore(const QModelIndex &parent) override;
+
+private slots:
+    void relationCreated(Relation * relation);
+    void coupleAdded(Relation * relation, Couple * couple);
+    void coupleRemoved(Relation * relation, Couple * couple);
+
+private:
+    const Note * m_note; /*!< The note whose relations are shown ; nullptr if there isn't */
+    RelationTreeNode * m_root; /*!< The root of the tree, parent of the relations */
+    QHash<const Relation*,RelationTreeNode*> m_relationNodes; /*!< The node of each relation */
+    QMultiHash<const Couple*,RelationTreeNode*> m_coupleNodes; /*!< The nodes of each couple built so far */
+
+    RelationTreeNode * nodeOf(const QModelIndex &index) const;
+    QModelIndex indexOf(RelationTreeNode * node) const;
+    QList<CoupleOfNote> listCouples(const RelationTreeNode * node) const;
+    RelationTreeNode * newCoupleNode(RelationTreeNode * parent, const Couple * couple, const Note * other);
+    void appendCouple(RelationTreeNode * parent, const Couple * couple, const Note * other);
+};
+
+#endif // RELATIONTREEMODEL_H
@@ -3,20 +3,19 @@
 
 #include "relation.h"
 #include "notesmanager.h"
-#include <QTreeWidget>
-#include <QTreeWidgetItem>
+#include "relationtreemodel.h"
+#include <QTreeView>
 #include <QStringList>
-#include <QTreeWidgetItemIterator>
 #include <QDebug>
 
 /**
  * \class RelationTreeView
- * \brief [Inherited from QTreeWidget] Class that defines the treeView on the right part of the interface
- *
+ * \brief [Inherited from QTreeView] Class that defines the treeView on the right part of the interface
  *
+ * Shows a RelationTreeModel : the couples of a relation are only read when the user expands it.
  */
 
-class RelationTreeView : public QTreeWidget
+class RelationTreeView : public QTreeView
 {
    Q_OBJECT
 
@@ -27,22 +26,16 @@ public:
 
 
 public slots:
-   void itemhasChanged(); /*!< Checks if the item selected has been changed */
+   void itemhasChanged(const QModelIndex &index); /*!< Checks if the item selected has been changed */
 
 signals:
-   void selectIdSignal(const QString& id); /*!< Emitted if the slot itemhasChanged is trigerred */
+   void selectNoteSignal(NoteHandle handle); /*!< Emitted with the handle of the note selected, if the slot itemhasChanged is trigerred */
 
 private:
-   //QTreeWidgetItem to fill the tree
-   QTreeWidgetItem *Desc; /*!< Descendant notes of the current note in a given relation */
-   QTreeWidgetItem *Asc; /*!< Ascendant notes of the current note in a given relation */
-   QTreeWidgetItem *relItem;  /*!< Relation item in the tree widget */
-   QTreeWidgetItem *noteToAdd; /*!< Item used to add all the childs */
-
    QString m_id; /*!< Refers to the current active Note ID */
+   RelationTreeModel *m_model; /*!< The model of the relations of the current note */
 
-
-   void addRelationToTree(); /*!< Adds the relations and its couples to the tree */
+   void addRelationToTree(); /*!< Shows the relations of the current note */
    NotesManager& manager;  /*!< Instance of the NotesManager */
 };
 
@@ -3,12 +3,19 @@
 RelationView::RelationView(QWidget *parent): QWidget(parent),manager(NotesManager::getInstance())
 {
     relationCombo = new QComboBox;
-    coupleTab = new QTableWidget;
-    coupleTab->setColumnCount(3);
-    QStringList ColumnNames;
-    ColumnNames<<"Label"<<"Note 1"<<"Note 2";
-    coupleTab->setHorizontalHeaderLabels(ColumnNames);
+    m_model = new RelationModel(this);
+    m_proxy = new QSortFilterProxyModel(this);
+    m_proxy->setSourceModel(m_model);
+    m_proxy->setSortCaseSensitivity(Qt::CaseInsensitive);
+
+    coupleTab = new QTableView;
+    coupleTab->setModel(m_proxy);
+    coupleTab->setEditTriggers(QAbstractItemView::NoEditTriggers);
     coupleTab->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
+    coupleTab->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+    // No column is sorted at first, so a large relation opens without sorting ; a click on a header sorts it
+    coupleTab->horizontalHeader()->setSortIndicator(-1, Qt::AscendingOrder);
+    coupleTab->setSortingEnabled(true);
 
     layout = new QVBoxLayout;
     layout->addWidget(relationCombo);
@@ -24,7 +31,7 @@ RelationView::RelationView(QWidget *parent): QWidget(parent),manager(NotesManage
     m_relation = relationCombo->currentText();
     addCoupleRelation(m_relation);
     connect(relationCombo,SIGNAL(currentIndexChanged(QString)),this,SLOT(selectedRelChanged(QString)));
-    connect(coupleTab,SIGNAL(itemClicked(QTableWidgetItem*)),this,SLOT(itemhasChanged()));
+    connect(coupleTab,SIGNAL(clicked(QModelIndex)),this,SLOT(itemhasChanged(QModelIndex)));
 }
 
 
@@ -33,11 +40,13 @@ void RelationView::selectedRelChanged(QString r)
     addCoupleRelation(r);
 }
 
-void RelationView::itemhasChanged()
+void RelationView::itemhasChanged(const QModelIndex &index)
 {
-    if (manager.findNote(coupleTab->currentItem()->text()) != nullptr)
+    // The cells of the notes hold their handle ; the one of the label holds nothing
+    const QVariant handle = index.data(Qt::UserRole);
+    if (handle.isValid() && manager.getNote(handle.toUInt()) != nullptr)
     {
-        emit selectIdSignal(coupleTab->currentItem()->text());
+        emit selectNoteSignal(handle.toUInt());
 
     }
 }
@@ -45,32 +54,5 @@ void RelationView::itemhasChanged()
 void RelationView::addCoupleRelation(const QString &r)
 {
     m_relation = r;
-    coupleTab->clearContents();
-    for (int i=0; i < coupleTab->rowCount(); i++)
-        coupleTab->removeRow(i);
-
-    Relation* relation = manager.findRelation(r);
-    Relation::const_iterator itC;
-    int row = 0;
-    for (itC = relation->cbegin(); itC != relation->cend(); itC++)
-    {
-        coupleTab->insertRow(row);
-        QTableWidgetItem *coupleLabel = new QTableWidgetItem;
-        QTableWidgetItem *coupleAsc = new QTableWidgetItem;
-        QTableWidgetItem *coupleDesc = new QTableWidgetItem;
-
-        coupleLabel->setText((*itC)->getLabel());
-        coupleAsc->setText((*itC)->getIdAsc());
-        coupleDesc->setText((*itC)->getIdDesc());
-
-        coupleLabel->setFlags(coupleLabel->flags() & ~Qt::ItemIsEditable);
-        coupleAsc->setFlags(coupleAsc->flags() & ~Qt::ItemIsEditable);
-        coupleDesc->setFlags(coupleDesc->flags() & ~Qt::ItemIsEditable);
-
-        coupleTab->setItem(row,0,coupleLabel);
-        coupleTab->setItem(row,1,coupleAsc);
-        coupleTab->setItem(row,2,coupleDesc);
-        row++;
-    }
+    m_model->setRelation(manager.findRelation(r));
 }
-
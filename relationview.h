@@ -3,15 +3,18 @@
 
 #include <QWidget>
 #include <QComboBox>
-#include <QTableWidget>
+#include <QTableView>
+#include <QSortFilterProxyModel>
 #include <QStringList>
 #include "notesmanager.h"
+#include "relationmodel.h"
 
 /**
  * \class RelationView
  * \brief [Inherited from QWidget] Class that defines the view of the couples of a given relation
  *
- * Using ComboBox to select the relation and QTableWidget to display the couples
+ * Using ComboBox to select the relation and a QTableView on a RelationModel to display the couples.
+ * The couples are sorted by label or by ID through a proxy, when the user clicks on a header.
  */
 
 
@@ -26,19 +29,20 @@ public:
     const QString& getRelation(){return m_relation;} /*!< Return the name of the relation selected */
 signals:
     void selectedRelSignal(); /*!< Emitted if the slot selectedRelChanged is trigerred*/
-    void selectIdSignal(const QString& id); /*!< Emitted if the slot itemhasChanged is trigerred*/
+    void selectNoteSignal(NoteHandle handle); /*!< Emitted with the handle of the note selected, if the slot itemhasChanged is trigerred*/
 public slots:
     void selectedRelChanged(QString r); /*!< Trigerred if the relation selected in the ComboBox changes*/
-    void itemhasChanged(); /*!< Trigerred if the item selected in the QTableView changes*/
+    void itemhasChanged(const QModelIndex &index); /*!< Trigerred if the item selected in the QTableView changes*/
 
 private:
-
     QString m_relation; /*!< Name of the relation selected. */
     NotesManager& manager;  /*!< Name of the relation selected. */
 
     //Interface widgets and layout
     QComboBox *relationCombo;  /*!< The combo to select the relation. */
-    QTableWidget *coupleTab; /*!< The widget to show the couples involved in the relations. */
+    QTableView *coupleTab; /*!< The widget to show the couples involved in the relations. */
+    RelationModel *m_model; /*!< The model reading the couples of the relation. */
+    QSortFilterProxyModel *m_proxy; /*!< The proxy sorting the couples for the view. */
     QVBoxLayout *layout; /*!< The layout containing the current widget to show.*/
 
 };
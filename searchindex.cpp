@@ -0,0 +1,211 @@
+#include "searchindex.h"
+#include <QtConcurrent>
+#include <cmath>
+#include <algorithm>
+
+const float TITLEWEIGHT = 3.0f; // A word of the title counts as much as three words of the body
+const int MINTERMLENGTH = 2; // Shorter words ("l", "d", "a"...) aren't indexed
+
+SearchIndex::SearchIndex(QObject *parent) : QObject(parent), m(NotesManager::getInstance()), m_ready(false)
+{
+    /*! The index is empty until build() is called. The changes of the notes are followed from now on. */
+    connect(&m_watcher, &QFutureWatcher<IndexData>::finished, this, &SearchIndex::buildFinished);
+    connect(&m, &NotesManager::noteCreated, this, &SearchIndex::noteChanged);
+    connect(&m, &NotesManager::noteVersionAdded, this, &SearchIndex::noteChanged);
+    connect(&m, &NotesManager::noteTitleChanged, this, &SearchIndex::noteChanged);
+    connect(&m, &NotesManager::noteErased, this, &SearchIndex::noteErased);
+}
+
+QString SearchIndex::fold(const QString &text)
+{
+    /*! Returns the text in lower case and without accents : the characters are decomposed and the marks are dropped. */
+    const QString decomposed = text.normalized(QString::NormalizationForm_D);
+    QString folded;
+    folded.reserve(decomposed.size());
+    for (QString::const_iterator it = decomposed.cbegin(); it != decomposed.cend(); ++it) {
+        if (it->category() != QChar::Mark_NonSpacing)
+            folded.append(it->toLower());
+    }
+    return folded;
+}
+
+QStringList SearchIndex::tokenize(const QString &text)
+{
+    /*! Splits the folded text in words made of letters and digits. */
+    const QString folded = fold(text);
+    QStringList tokens;
+    int start = -1;
+    for (int i = 0; i <= folded.size(); i++) {
+        bool inWord = i < folded.size() && folded.at(i).isLetterOrNumber();
+        if (inWord && start < 0)
+            start = i;
+        else if (!inWord && start >= 0) {
+            if (i - start >= MINTERMLENGTH)
+                tokens.append(folded.mid(start, i - start));
+            start = -1;
+        }
+    }
+    return tokens;
+}
+
+NoteText SearchIndex::textOf(const Note *note)
+{
+    /*! Copies the searchable text of the note : its title and the main field of its latest version. */
+    NoteText text;
+    text.handle = note->getHandle();
+    text.title = note->getTitle();
+    const Version * last = note->getLastversion();
+    if (last == nullptr)
+        return text;
+    switch (note->getType()) {
+    case ArticleType:
+        text.body = version_cast<Article>(last)->getText();
+        break;
+    case MediaType:
+        text.body = version_cast<Media>(last)->getDescription();
+        break;
+    case TaskType:
+        text.body = version_cast<Task>(last)->getAction();
+        break;
+    case EmptyType:
+    default:
+        break;
+    }
+    return text;
+}
+
+void SearchIndex::addNote(IndexData &data, const NoteText &text)
+{
+    /*! Adds the postings of the note. The note must not be in the index. */
+    QHash<QString,float> weights;
+    const QStringList titleTokens = tokenize(text.title);
+    for (QStringList::const_iterator it = titleTokens.cbegin(); it != titleTokens.cend(); ++it)
+        weights[*it] += TITLEWEIGHT;
+    const QStringList bodyTokens = tokenize(text.body);
+    for (QStringList::const_iterator it = bodyTokens.cbegin(); it != bodyTokens.cend(); ++it)
+        weights[*it] += 1.0f;
+
+    for (QHash<QString,float>::const_iterator it = weights.cbegin(); it != weights.cend(); ++it)
+        data.postings[it.key()].insert(text.handle, it.value());
+    data.terms.insert(text.handle, weights.keys());
+}
+
+void SearchIndex::removeNote(IndexData &data, NoteHandle handle)
+{
+    /*! Removes the postings of the note, if it is in the index. */
+    const QStringList terms = data.terms.take(handle);
+    for (QStringList::const_iterator it = terms.cbegin(); it != terms.cend(); ++it) {
+        QHash<QString,Postings>::iterator itP = data.postings.find(*it);
+        if (itP == data.postings.end())
+            continue;
+        itP.value().remove(handle);
+        if (itP.value().isEmpty())
+            data.postings.erase(itP);
+    }
+}
+
+IndexData SearchIndex::buildIndex(const QList<NoteText> &texts)
+{
+    /*! Builds an index from a copy of the notes. Runs on a worker thread : it doesn't touch the notes themselves. */
+    IndexData data;
+    data.terms.reserve(texts.size());
+    for (QList<NoteText>::const_iterator it = texts.cbegin(); it != texts.cend(); ++it)
+        addNote(data, *it);
+    return data;
+}
+
+void SearchIndex::build()
+{
+    /*! Copies the text of the notes in the GUI thread, then tokenizes and indexes it on a worker thread. */
+    if (m_watcher.isRunning())
+        return;
+    QList<NoteText> texts;
+    texts.reserve(m.getNbNotes());
+    for (NotesManager::const_iteratorNote it = m.cbeginNote(); it != m.cendNote(); it++)
+        texts.append(textOf(*it));
+    m_ready = false;
+    m_changedDuringBuild.clear();
+    m_watcher.setFuture(QtConcurrent::run(&SearchIndex::buildIndex, texts));
+}
+
+void SearchIndex::buildFinished()
+{
+    /*! Takes the index built by the worker and indexes again the notes that changed in the meantime. */
+    m_data = m_watcher.result();
+    for (QSet<NoteHandle>::const_iterator it = m_changedDuringBuild.cbegin(); it != m_changedDuringBuild.cend(); ++it) {
+        removeNote(m_data, *it);
+        const Note * note = m.getNote(*it);
+        if (note != nullptr)
+            addNote(m_data, textOf(note));
+    }
+    m_changedDuringBuild.clear();
+    m_ready = true;
+    emit ready();
+}
+
+void SearchIndex::noteChanged(Note *note)
+{
+    /*! Indexes the note again : only its own postings are updated. */
+    if (m_watcher.isRunning()) {
+        m_changedDuringBuild.insert(note->getHandle());
+        return;
+    }
+    removeNote(m_data, note->getHandle());
+    addNote(m_data, textOf(note));
+}
+
+void SearchIndex::noteErased(Note *note)
+{
+    /*! Removes the note from the index. */
+    if (m_watcher.isRunning()) {
+        m_changedDuringBuild.insert(note->getHandle());
+        return;
+    }
+    removeNote(m_data, note->getHandle());
+}
+
+QList<NoteHandle> SearchIndex::search(const QString &query, int limit) const
+{
+    /*! Returns the handles of the notes containing all the words of the query, the most relevant first.
+     * The postings are intersected starting from the rarest word, and each note is scored by tf-idf. */
+    QList<NoteHandle> result;
+    QStringList words = tokenize(query);
+    words.removeDuplicates();
+    if (words.isEmpty())
+        return result;
+
+    QList<const Postings*> lists;
+    for (QStringList::const_iterator it = words.cbegin(); it != words.cend(); ++it) {
+        QHash<QString,Postings>::const_iterator itP = m_data.postings.constFind(*it);
+        if (itP == m_data.postings.constEnd())
+            return result; // A word is in no note
+        lists.append(&itP.value());
+    }
+    std::sort(lists.begin(), lists.end(), [](const Postings* first, const Postings* second) { return first->size() < second->size(); });
+
+    const float nbNotes = m_data.terms.size();
+    QList<QPair<float,NoteHandle>> scored;
+    const Postings * rarest = lists.first();
+    for (Postings::const_iterator itN = rarest->cbegin(); itN != rarest->cend(); ++itN) {
+        float score = 0;
+        bool inAll = true;
+        for (QList<const Postings*>::const_iterator itL = lists.cbegin(); inAll && itL != lists.cend(); ++itL) {
+            Postings::const_iterator itW = (*itL)->constFind(itN.key());
+            if (itW == (*itL)->constEnd())
+                inAll = false;
+            else
+                score += itW.value() * std::log(1.0f + nbNotes / (*itL)->size());
+        }
+        if (inAll)
+            scored.append(qMakePair(score, itN.key()));
+    }
+
+    int nbResults = qMin(limit, scored.size());
+    std::partial_sort(scored.begin(), scored.begin() + nbResults, scored.end(),
+                      [](const QPair<float,NoteHandle>& first, const QPair<float,NoteHandle>& second) {
+                          return first.first > second.first || (first.first == second.first && first.second < second.second);
+                      });
+    for (int i = 0; i < nbResults; i++)
+        result.append(scored.at(i).second);
+    return result;
+}
@@ -0,0 +1,73 @@
+#ifndef SEARCHINDEX_H
+#define SEARCHINDEX_H
+
+#include <QObject>
+#include <QHash>
+#include <QSet>
+#include <QStringList>
+#include <QFutureWatcher>
+#include "notesmanager.h"
+
+typedef QHash<NoteHandle,float> Postings; /*!< Weight of a term in each note containing it, indexed by the handle of the note. */
+
+/*! \struct NoteText
+ *  \brief Copy of the searchable text of a note, so the index can be built outside of the GUI thread.
+ */
+struct NoteText {
+    NoteHandle handle; /*!< Handle of the note. */
+    QString title; /*!< Title of the note. */
+    QString body; /*!< Text, description or action of the latest version of the note. */
+};
+
+/*! \struct IndexData
+ *  \brief The inverted index itself : the postings of each term and the terms of each note.
+ */
+struct IndexData {
+    QHash<QString,Postings> postings; /*!< Notes containing each term, with the weight of the term in the note. */
+    QHash<NoteHandle,QStringList> terms; /*!< Terms of each note, used to remove its postings when it changes. */
+};
+
+/*! \class SearchIndex
+ *  \brief [Inherited from QObject] In-memory inverted index on the title and the latest version of the notes.
+ *
+ *  The words are folded (lower case, accents removed) so that "evenement" finds "Événement".
+ *  The index is built once on a worker thread, then follows the changes of the notes through the signals of the NotesManager.
+ *  The results are ranked by tf-idf, a word of the title weighing more than a word of the body.
+ */
+class SearchIndex : public QObject
+{
+    Q_OBJECT
+public:
+    SearchIndex(QObject *parent = nullptr);
+
+    bool isReady() const {return m_ready;} /*!< Returns true once the index is built. */
+    QList<NoteHandle> search(const QString& query, int limit = 50) const;
+
+    static QString fold(const QString& text);
+    static QStringList tokenize(const QString& text);
+
+public slots:
+    void build(); /*!< Takes a copy of the notes' text and builds the index on a worker thread. */
+
+signals:
+    void ready(); /*!< Emitted when the index is built. */
+
+private slots:
+    void buildFinished();
+    void noteChanged(Note * note);
+    void noteErased(Note * note);
+
+private:
+    NotesManager& m; /*!< Instance of the NotesManager */
+    IndexData m_data; /*!< The index. */
+    bool m_ready; /*!< True once the index is built. */
+    QSet<NoteHandle> m_changedDuringBuild; /*!< Handles of the notes changed while the index was built ; they are indexed again at the end. */
+    QFutureWatcher<IndexData> m_watcher; /*!< Watches the build on the worker thread. */
+
+    static NoteText textOf(const Note * note);
+    static IndexData buildIndex(const QList<NoteText>& texts);
+    static void addNote(IndexData& data, const NoteText& text);
+    static void removeNote(IndexData& data, NoteHandle handle);
+};
+
+#endif // SEARCHINDEX_H
@@ -1,4 +1,7 @@
 #include "tablemodel.h"
+#include <algorithm>
+
+const int ROWSPAGE = 50; // Number of rows given to the view by fetchMore()
 
 /*
     C'est ici que se passe la "mise en forme" des données pour qu'elles correspondent à un tableau
@@ -8,18 +11,58 @@
 */
 
 
-TableModel::TableModel() : m(NotesManager::getInstance())
+TableModel::TableModel() : m(NotesManager::getInstance()), m_fetchedRows(0)
 {
-
+    /*! Builds the columns from the notes of the NotesManager, then follows its changes. */
+    for(NotesManager::iteratorNote it = m.beginNote(active); it!=m.endNote(active);it++)
+    {
+        if(isShown(*it))
+            m_columns[(*it)->getType()].append(*it);
+    }
+    for(int column = 0; column < 3; column++)
+        std::sort(m_columns[column].begin(), m_columns[column].end(), isBefore);
+    // Only the first page is given to the view ; the next ones are fetched when it scrolls
+    m_fetchedRows = qMin(ROWSPAGE, totalRows());
+
+    connect(&m, &NotesManager::noteVersionAdded, this, &TableModel::noteVersionAdded);
+    connect(&m, &NotesManager::noteStateChanged, this, &TableModel::noteStateChanged);
+    connect(&m, &NotesManager::noteTitleChanged, this, &TableModel::noteTitleChanged);
 }
 
 int TableModel::rowCount(const QModelIndex &parent) const
 {
     Q_UNUSED(parent);
-    /*! Return the number of activated notes in the notemanager, in order to set the number of rows */
+    /*! Return the number of rows fetched by the view so far */
+
+    return m_fetchedRows;
+
+}
 
-    return m.getRowCount(); // Getting the number of lines from the NotesManager
+int TableModel::totalRows() const
+{
+    /*! Returns the size of the longest column, fetched or not */
+    return qMax(qMax(m_columns[ArticleType].size(), m_columns[MediaType].size()), m_columns[TaskType].size());
+}
 
+bool TableModel::canFetchMore(const QModelIndex &parent) const
+{
+    /*! Returns true while some rows haven't been given to the view. */
+    if(parent.isValid())
+        return false;
+    return m_fetchedRows < totalRows();
+}
+
+void TableModel::fetchMore(const QModelIndex &parent)
+{
+    /*! Gives the next page of rows to the view. */
+    if(parent.isValid())
+        return;
+    int nbRows = qMin(ROWSPAGE, totalRows() - m_fetchedRows);
+    if(nbRows <= 0)
+        return;
+    beginInsertRows(QModelIndex(), m_fetchedRows, m_fetchedRows + nbRows - 1);
+    m_fetchedRows += nbRows;
+    endInsertRows();
 }
 
 int TableModel::columnCount(const QModelIndex &parent) const
@@ -30,98 +73,160 @@ int TableModel::columnCount(const QModelIndex &parent) const
     return 3; //  (Task/Media/Article)
 }
 
-int TableModel::indexNextTask(QList<Note*> list, int i) const
+bool TableModel::isBefore(const Note *first, const Note *second)
 {
-    /*! Return the index in the Task column. */
-    while(i < list.size() && list[i]->getType() != TaskType)
+    /*! Order of the notes in a column : the tasks are sorted by deadline (the latest first), then by ID ; the other notes by ID. */
+    if(first->getType() == TaskType)
     {
-        i++;
+        const Task *t1 = version_cast<Task>(first->getLastversion());
+        const Task *t2 = version_cast<Task>(second->getLastversion());
+        if(t1->getDeadLine() != t2->getDeadLine())
+            return t2->getDeadLine() < t1->getDeadLine();
     }
-    return i;
+    return first->getId() < second->getId();
 }
 
-
-QVariant TableModel::data(const QModelIndex &index, int role) const
+QVector<Note*>::iterator TableModel::findPlace(Note *note)
 {
-    /*! Return the note associated to the case at the index index */
+    /*! Returns the place where the note has to be inserted in its column. The note must not be in the column. */
+    QVector<Note*> &notes = m_columns[note->getType()];
+    return std::lower_bound(notes.begin(), notes.end(), note, isBefore);
+}
 
-    // Enables the view to get the data to show
-    QVariant v;
-    Dico mapToSend;
+void TableModel::cellsChanged(int column, int firstRow, int lastRow)
+{
+    /*! Notifies the view that the cells of a column between the two rows have changed. */
+    lastRow = qMin(lastRow, rowCount()-1);
+    if(firstRow <= lastRow)
+        emit dataChanged(index(firstRow, column), index(lastRow, column));
+}
 
-    NotesManager::iteratorNote it = m.beginNote();
+void TableModel::insertNote(Note *note)
+{
+    /*! Inserts the note in its column. A row is added if the column becomes the longest one and all the rows were fetched ;
+     * otherwise the new row will come with the next page. */
+    int column = note->getType();
+    QVector<Note*> &notes = m_columns[column];
+    int row = findPlace(note) - notes.begin();
 
-    int i=0, j = 0;
+    if(notes.size() == totalRows() && m_fetchedRows == totalRows())
+    {
+        beginInsertRows(QModelIndex(), notes.size(), notes.size());
+        notes.insert(row, note);
+        m_fetchedRows++;
+        endInsertRows();
+    }
+    else
+        notes.insert(row, note);
 
-    QList<Note*> sortedListNote;
+    // The next notes of the column have moved down
+    cellsChanged(column, row, notes.size()-1);
+}
 
-    for(it = m.beginNote(); it!=m.endNote();it++)
+void TableModel::removeNote(Note *note)
+{
+    /*! Removes the note from its column. The last row is removed if no other column is as long and it was fetched. */
+    int column = note->getType();
+    QVector<Note*> &notes = m_columns[column];
+    int row = notes.indexOf(note);
+    if(row < 0)
+        return;
+
+    int oldRowCount = rowCount();
+    int newRowCount = notes.size()-1;
+    for(int other = 0; other < 3; other++)
     {
-        if((*it)->getState() == active)
-            sortedListNote.append(*it);
+        if(other != column)
+            newRowCount = qMax(newRowCount, m_columns[other].size());
+    }
+    newRowCount = qMin(newRowCount, m_fetchedRows);
 
+    if(newRowCount < oldRowCount)
+    {
+        beginRemoveRows(QModelIndex(), newRowCount, oldRowCount-1);
+        notes.remove(row);
+        m_fetchedRows = newRowCount;
+        endRemoveRows();
     }
+    else
+        notes.remove(row);
 
-    int k = 0;
-    int l;
-    bool swapped = true;
+    // The next notes of the column have moved up, and the last cell is now empty
+    cellsChanged(column, row, notes.size());
+}
 
-    while(swapped)
+void TableModel::noteVersionAdded(Note *note)
+{
+    /*! A note gets its place in the table with its first version ; a new version of a task can move it in its column. */
+    if(!isShown(note))
+        return;
+    int column = note->getType();
+    QVector<Note*> &notes = m_columns[column];
+    int oldRow = notes.indexOf(note);
+    if(oldRow < 0)
     {
-        swapped = false;
-        k++;
-        for(l = 0;l<sortedListNote.size()-1;l++)
-        {
-            if(sortedListNote[l]->getType() == TaskType)
-            {
-                int nextIndex = indexNextTask(sortedListNote, l+1);
-                Task *t1 = dynamic_cast<Task*>(sortedListNote[l]->getLastversion());
-                Task *t2 = dynamic_cast<Task*>(sortedListNote[nextIndex]->getLastversion());
-
-                if(t1->getDeadLine() < t2->getDeadLine())
-                {
-                    swapped = true;
-                    sortedListNote.swap(l, nextIndex);
-                }
-            }
-        }
+        insertNote(note);
+        return;
     }
+    notes.remove(oldRow);
+    int newRow = findPlace(note) - notes.begin();
+    notes.insert(newRow, note);
+    cellsChanged(column, qMin(oldRow, newRow), qMax(oldRow, newRow));
+}
 
+void TableModel::noteStateChanged(Note *note, NoteState oldState)
+{
+    /*! Only the active notes are shown in the table. */
+    if(oldState == active)
+        removeNote(note);
+    else if(isShown(note))
+        insertNote(note);
+}
 
-    for(i = 0;i<sortedListNote.count();i++)
-    {
-        if(index.column() == sortedListNote.at(i)->getType())
-        {
-            if(j == index.row())
-                break;
-            j++;
-        }
+void TableModel::noteTitleChanged(Note *note)
+{
+    /*! Refreshes the cell of the note. */
+    int row = m_columns[note->getType()].indexOf(note);
+    if(row >= 0)
+        cellsChanged(note->getType(), row, row);
+}
 
-    }
-    if(i == sortedListNote.count())
+
+QVariant TableModel::data(const QModelIndex &index, int role) const
+{
+    /*! Return the note associated to the case at the index index */
+
+    // Enables the view to get the data to show
+    QVariant v;
+    Dico mapToSend;
+
+    if(index.column() < 0 || index.column() >= 3 || index.row() >= m_columns[index.column()].size())
         return QVariant();
 
+    const Note *note = m_columns[index.column()].at(index.row());
+
      if(role == Qt::DisplayRole)
      {
 
-         mapToSend["id"] = sortedListNote.at(i)->getId();
-         mapToSend["title"] = sortedListNote.at(i)->getTitle();
-         mapToSend["state"] = sortedListNote.at(i)->getState();
-         mapToSend["creatDate"] = sortedListNote.at(i)->getCreationDateTime();
-         mapToSend["lastUpdate"] = sortedListNote.at(i)->getLastversion()->getModifDate();
+         mapToSend["id"] = note->getId();
+         mapToSend["title"] = note->getTitle();
+         mapToSend["state"] = note->getState();
+         mapToSend["creatDate"] = note->getCreationDateTime();
+         mapToSend["lastUpdate"] = note->getLastversion()->getModifDate();
+         mapToSend["handle"] = note->getHandle();
 
          switch(index.column())
          {
          case ArticleType:
          {
-             Article *a = dynamic_cast<Article*>(sortedListNote.at(i)->getLastversion());
+             const Article *a = version_cast<Article>(note->getLastversion());
              mapToSend["text"] = a->getText();
 
              break;
          }
          case MediaType:
             {
-             Media *a = dynamic_cast<Media*>(sortedListNote.at(i)->getLastversion());
+             const Media *a = version_cast<Media>(note->getLastversion());
 
              mapToSend["description"] = a->getDescription();
              mapToSend["filename"] = a->getFileName();
@@ -130,7 +235,7 @@ QVariant TableModel::data(const QModelIndex &index, int role) const
          case TaskType:
             {
 
-             Task *a = dynamic_cast<Task*>(sortedListNote.at(i)->getLastversion());
+             const Task *a = version_cast<Task>(note->getLastversion());
              mapToSend["action"] = a->getAction();
              mapToSend["priority"] = a->getPriority();
              mapToSend["deadLine"] = a->getDeadLine();
@@ -196,14 +301,11 @@ bool TableModel::setData(const QModelIndex &index, const QVariant &value, int ro
     Q_UNUSED(role);
     Dico dataReceived = value.value<Dico>();
 
-    for(NotesManager::iteratorNote it = m.beginNote(); it!=m.endNote();it++)
-    {
-        if((*it)->getId() == dataReceived["id"].toString())
-        {
-            (*it)->setTitle(dataReceived["title"].toString());
-            (*it)->createVersion(dataReceived);
-        }
-    }
+    Note *note = m.findNote(dataReceived["id"].toString());
+    if(note == nullptr)
+        return false;
+    note->setTitle(dataReceived["title"].toString());
+    note->createVersion(dataReceived);
     return true;
 }
 
@@ -12,11 +12,15 @@
  * \brief [Inherited from QAbstractTableModel] Class that defines which data is shown in the tableview
  *
  * Overrides pure virtual functions
- * in order to show and to edit the notes with the tableview
+ * in order to show and to edit the notes with the tableview.
+ * The active notes are kept in one vector per column, updated from the signals of the NotesManager :
+ * the articles and the media are sorted by ID, the tasks by deadline (the latest first).
+ * The rows are given to the view by pages, with canFetchMore() and fetchMore(), as the user scrolls.
  *
  */
 class TableModel : public QAbstractTableModel
 {
+    Q_OBJECT
 public:
     TableModel();
 
@@ -25,9 +29,27 @@ public:
     QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
     QVariant headerData(int section, Qt::Orientation orientation, int role) const override;
     bool setData(const QModelIndex &index, const QVariant &value, int role = Qt::EditRole) override;
-    int indexNextTask(QList<Note*> list, int i) const;
+    bool canFetchMore(const QModelIndex &parent) const override;
+    void fetchMore(const QModelIndex &parent) override;
+
+private slots:
+    void noteVersionAdded(Note * note);
+    void noteStateChanged(Note * note, NoteState oldState);
+    void noteTitleChanged(Note * note);
+
 private:
     NotesManager &m; /*!< Instance of the NotesManager */
+    QVector<Note*> m_columns[3]; /*!< The notes shown in each column, in the order of the rows */
+    int m_fetchedRows; /*!< Number of rows given to the view so far. Never more than totalRows(). */
+
+    int totalRows() const;
+
+    static bool isShown(const Note * note) { return note->getState() == active && note->getLastversion() != nullptr;} /*!< Returns true if the note has its place in the table. */
+    static bool isBefore(const Note * first, const Note * second);
+    QVector<Note*>::iterator findPlace(Note * note);
+    void insertNote(Note * note);
+    void removeNote(Note * note);
+    void cellsChanged(int column, int firstRow, int lastRow);
 };
 
 #endif // TABLEMODEL_H
@@ -0,0 +1,151 @@
+#include "thumbnailservice.h"
+#include <QtConcurrent>
+#include <QCryptographicHash>
+#include <QImageReader>
+#include <QStandardPaths>
+#include <QMediaPlayer>
+#include <QDir>
+#include <QUrl>
+#include <QTimer>
+
+const int THUMBNAILSINMEMORY = 64; // Number of thumbnails kept in memory
+const QString THUMBNAILFOLDER = "thumbnails"; // Folder of the thumbnails, in the cache folder of the application
+const int DURATIONTIMEOUT = 10000; // Milliseconds after which the probe of a duration is given up
+
+ThumbnailService::Handler ThumbnailService::handler=Handler();
+
+ThumbnailService::ThumbnailService() : m_thumbnails(THUMBNAILSINMEMORY)
+{
+    /*! Creates the folder of the thumbnails on the disk. */
+    m_cacheFolder = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/" + THUMBNAILFOLDER;
+    QDir().mkpath(m_cacheFolder);
+}
+
+ThumbnailService::~ThumbnailService()
+{
+    /*! Waits for the images being decoded ; the players of the probes are deleted with the children of the service. */
+    m_pool.waitForDone();
+}
+
+ThumbnailService &ThumbnailService::getInstance()
+{
+    /*! Returns the unique instance of the ThumbnailService. */
+    if (!handler.instance)
+        handler.instance = new ThumbnailService;
+    return *handler.instance;
+}
+
+void ThumbnailService::freeService()
+{
+    /*! Deletes the unique instance of the ThumbnailService : the images being decoded are waited for, then the players
+     * still probing a duration are deleted with it. */
+    delete handler.instance;
+    handler.instance = nullptr;
+}
+
+QString ThumbnailService::keyOf(const QFileInfo &file, const QSize &size)
+{
+    /*! Returns the key of a file : a hash of its path, its date of modification, its size and the size of the thumbnail. */
+    QString description = QString("%1|%2|%3|%4x%5").arg(file.absoluteFilePath()).arg(file.lastModified().toMSecsSinceEpoch())
+            .arg(file.size()).arg(size.width()).arg(size.height());
+    return QString(QCryptographicHash::hash(description.toUtf8(), QCryptographicHash::Sha1).toHex());
+}
+
+QImage ThumbnailService::loadThumbnail(const QString &path, const QString &cacheFile, const QSize &size)
+{
+    /*! Runs on a thread of the pool. Reads the thumbnail from the cache on the disk, or decodes the image downscaled and saves it there. */
+    QImage image;
+    if (image.load(cacheFile, "PNG"))
+        return image;
+
+    QImageReader reader(path);
+    reader.setAutoTransform(true);
+    // The decoder scales the image while reading it : the full resolution is never in memory
+    QSize original = reader.size();
+    if (original.isValid() && (original.width() > size.width() || original.height() > size.height()))
+        reader.setScaledSize(original.scaled(size, Qt::KeepAspectRatio));
+    image = reader.read();
+    if (!image.isNull())
+        image.save(cacheFile, "PNG");
+    return image;
+}
+
+void ThumbnailService::requestThumbnail(const QString &path, const QSize &size)
+{
+    /*! Asks for the thumbnail of the image, fitting in size. thumbnailReady() is emitted at once if it is in memory,
+     * otherwise when it is read from the disk or decoded by the pool. */
+    QFileInfo file(path);
+    if (!file.isFile())
+        return;
+    const QString key = keyOf(file, size);
+    QImage * image = m_thumbnails.object(key);
+    if (image != nullptr)
+    {
+        emit thumbnailReady(path, *image);
+        return;
+    }
+    if (m_pending.contains(key))
+        return;
+    m_pending.insert(key);
+
+    QFutureWatcher<QImage> * watcher = new QFutureWatcher<QImage>(this);
+    connect(watcher, &QFutureWatcher<QImage>::finished, this, [=]{
+        QImage result = watcher->result();
+        m_pending.remove(key);
+        if (!result.isNull())
+        {
+            m_thumbnails.insert(key, new QImage(result));
+            emit thumbnailReady(path, result);
+        }
+        watcher->deleteLater();
+    });
+    watcher->setFuture(QtConcurrent::run(&m_pool, &ThumbnailService::loadThumbnail, path, m_cacheFolder + "/" + key + ".png", size));
+}
+
+void ThumbnailService::requestDuration(const QString &path)
+{
+    /*! Asks for the duration of the sound or the video. It is probed by a hidden player, which loads the media in the background ;
+     * durationReady() is emitted when it is known. The probe is given up if the media is invalid, if it is loaded without
+     * a duration or after DURATIONTIMEOUT. */
+    QFileInfo file(path);
+    if (!file.isFile())
+        return;
+    const QString key = keyOf(file);
+    QHash<QString,qint64>::const_iterator itD = m_durations.constFind(key);
+    if (itD != m_durations.constEnd())
+    {
+        emit durationReady(path, itD.value());
+        return;
+    }
+    if (m_pending.contains(key))
+        return;
+    m_pending.insert(key);
+
+    QMediaPlayer * probe = new QMediaPlayer(this);
+    QTimer * timeout = new QTimer(probe);
+    timeout->setSingleShot(true);
+    // Every way out deletes the probe and forgets the key, so the file can be probed again if it gave nothing
+    auto finish = [=](qint64 duration){
+        disconnect(probe, nullptr, this, nullptr);
+        disconnect(timeout, nullptr, this, nullptr);
+        m_pending.remove(key);
+        if (duration > 0)
+        {
+            m_durations.insert(key, duration);
+            emit durationReady(path, duration);
+        }
+        probe->deleteLater();
+    };
+    connect(probe, &QMediaPlayer::durationChanged, this, [=](qint64 duration){
+        if (duration > 0)
+            finish(duration);
+    });
+    connect(probe, &QMediaPlayer::mediaStatusChanged, this, [=](QMediaPlayer::MediaStatus status){
+        // The file can't be read, or it is loaded without a duration : the probe is given up
+        if (status == QMediaPlayer::InvalidMedia || (status == QMediaPlayer::LoadedMedia && probe->duration() <= 0))
+            finish(0);
+    });
+    connect(timeout, &QTimer::timeout, this, [=]{ finish(0); });
+    timeout->start(DURATIONTIMEOUT);
+    probe->setMedia(QUrl::fromLocalFile(file.absoluteFilePath()));
+}
@@ -0,0 +1,61 @@
+#ifndef THUMBNAILSERVICE_H
+#define THUMBNAILSERVICE_H
+
+#include <QObject>
+#include <QImage>
+#include <QSize>
+#include <QCache>
+#include <QHash>
+#include <QSet>
+#include <QThreadPool>
+#include <QFileInfo>
+
+/*! \class ThumbnailService
+ *  \brief [Inherited from QObject] Decodes the thumbnails of the images and probes the duration of the sounds and videos in the background.
+ *
+ *  Is implemented under the Singleton Design Pattern.
+ *  The images are decoded already downscaled on a thread pool, then kept in memory and in a cache on the disk.
+ *  The entries are identified by the path, the date of modification and the size of the file, so a modified file is decoded again.
+ *  The results are given with the signals thumbnailReady() and durationReady().
+ *  The service has to be freed with freeService() before the application is destroyed : the threads of its pool and the
+ *  backends of its media players can't be stopped without an event loop.
+ */
+class ThumbnailService : public QObject
+{
+    Q_OBJECT
+public:
+    static ThumbnailService& getInstance(); /*!< Gives the unique instance of the ThumbnailService */
+    static void freeService(); /*!< Waits for the thumbnails being decoded and deletes the unique instance, with its probes ; to call while the application still runs */
+
+    void requestThumbnail(const QString& path, const QSize& size);
+    void requestDuration(const QString& path);
+
+signals:
+    void thumbnailReady(const QString& path, const QImage& image); /*!< Emitted when the thumbnail of the file is available */
+    void durationReady(const QString& path, qint64 duration); /*!< Emitted when the duration of the file (in ms) is known */
+
+private:
+    ThumbnailService();
+    ~ThumbnailService();
+
+    /*! \struct ThumbnailService::Handler
+     *  \brief The class that handles the unique instance of ThumbnailService for the Singleton.
+     */
+    struct Handler {
+        ThumbnailService *instance; /*!< Points on the unique instance of ThumbnailService */
+        Handler():instance(nullptr){}
+        ~Handler() { delete instance; }
+    };
+    static Handler handler; /*!< The handler of the unique instance of the service */
+
+    QThreadPool m_pool; /*!< The threads decoding the images */
+    QString m_cacheFolder; /*!< The folder of the thumbnails on the disk */
+    QCache<QString,QImage> m_thumbnails; /*!< The thumbnails in memory, indexed by their key */
+    QHash<QString,qint64> m_durations; /*!< The durations already probed, indexed by the key of the file */
+    QSet<QString> m_pending; /*!< Keys of the thumbnails and durations being computed */
+
+    static QString keyOf(const QFileInfo& file, const QSize& size = QSize());
+    static QImage loadThumbnail(const QString& path, const QString& cacheFile, const QSize& size);
+};
+
+#endif // THUMBNAILSERVICE_H
@@ -19,13 +19,10 @@ Trash::Trash() : m(NotesManager::getInstance())
     m_interface = new ArticleStrategy();
 
     //Find the selected note
-    for(itNotes = m.beginNote(); itNotes!=m.endNote();itNotes++)
+    for(itNotes = m.beginNote(dustbin); itNotes!=m.endNote(dustbin);itNotes++)
     {
-        if((*itNotes)->getState() == dustbin)
-        {
-            listBin->addItem((*itNotes)->getId());
-            binNotes.append(*itNotes);
-        }
+        listBin->addItem((*itNotes)->getId());
+        binNotes.append(*itNotes);
     }
 
     connect(listBin, SIGNAL(currentRowChanged(int)), this, SLOT(showData(int)));
@@ -44,14 +41,14 @@ void Trash::showData(int row)
     {
        case ArticleType:
        {
-            Article *a = dynamic_cast<Article*>((*(binNotes.begin()+row))->getLastversion());
+            Article *a = version_cast<Article>((*(binNotes.begin()+row))->getLastversion());
             m_interface = new ArticleStrategy((*(binNotes.begin()+row))->getId(), (*(binNotes.begin()+row))->getTitle(),
                                               a->getText(),(*(binNotes.begin()+row))->getCreationDateTime().toString(DATEFORMAT), a->getModifDate().toString(DATEFORMAT));
             break;
        }
        case MediaType:
        {
-            Media *med = dynamic_cast<Media*>((*(binNotes.begin()+row))->getLastversion());
+            Media *med = version_cast<Media>((*(binNotes.begin()+row))->getLastversion());
             m_interface = new MediaStrategy((*(binNotes.begin()+row))->getId(), (*(binNotes.begin()+row))->getTitle(),
                                             med->getDescription(), med->getFileName(),(*(binNotes.begin()+row))->getCreationDateTime().toString(DATEFORMAT),
                                             med->getModifDate().toString(DATEFORMAT));
@@ -59,7 +56,7 @@ void Trash::showData(int row)
        }
        case TaskType:
        {
-            Task *t = dynamic_cast<Task*>((*(binNotes.begin()+row))->getLastversion());
+            Task *t = version_cast<Task>((*(binNotes.begin()+row))->getLastversion());
             m_interface = new TaskStrategy((*(binNotes.begin()+row))->getId(), (*(binNotes.begin()+row))->getTitle(),
                                            t->getAction(), t->getPriority(), t->getDeadLine(), (*(binNotes.begin()+row))->getCreationDateTime().toString(DATEFORMAT),
                                            t->getModifDate().toString(DATEFORMAT));
@@ -3,7 +3,7 @@
 const QString DATEFORMAT = "yyyy-MM-dd hh:mm:ss";
 
 
-VersionDialog::VersionDialog(const QString &idnote) : m(NotesManager::getInstance()), itNotes(m.beginNote()), itVersion((*itNotes)->begin())
+VersionDialog::VersionDialog(const QString &idnote) : m(NotesManager::getInstance()), itNotes(m.beginNote()), itVersion()
 {
     /*! Displays a list of all the versions of a note */
     setWindowTitle("Affichage des versions");
@@ -58,21 +58,21 @@ void VersionDialog::showData(int row)
     {
        case ArticleType:
        {
-            Article *a = dynamic_cast<Article*>(*((*itNotes)->begin()+row));
+            Article *a = version_cast<Article>(*((*itNotes)->begin()+row));
             m_interface = new ArticleStrategy((*itNotes)->getId(), (*itNotes)->getTitle(),
                                               a->getText(),(*itNotes)->getCreationDateTime().toString(DATEFORMAT), a->getModifDate().toString(DATEFORMAT));
             break;
        }
        case MediaType:
        {
-           Media *med = dynamic_cast<Media*>(*((*itNotes)->begin()+row));
+           Media *med = version_cast<Media>(*((*itNotes)->begin()+row));
             m_interface = new MediaStrategy((*itNotes)->getId(), (*itNotes)->getTitle(),
                                             med->getDescription(), med->getFileName(),(*itNotes)->getCreationDateTime().toString(DATEFORMAT), med->getModifDate().toString(DATEFORMAT));
             break;
        }
        case TaskType:
        {
-           Task *t = dynamic_cast<Task*>(*((*itNotes)->begin()+row));
+           Task *t = version_cast<Task>(*((*itNotes)->begin()+row));
             m_interface = new TaskStrategy((*itNotes)->getId(), (*itNotes)->getTitle(),
                                            t->getAction(), t->getPriority(), t->getDeadLine(), (*itNotes)->getCreationDateTime().toString(DATEFORMAT), t->getModifDate().toString(DATEFORMAT));
             break;
@@ -0,0 +1,96 @@
+#ifndef VERSIONPOOL_H
+#define VERSIONPOOL_H
+
+#include <QVector>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+/*! \class VersionPool
+ *  \brief Template pool allocating the versions of one type (Article, Media or Task) by chunks.
+ *
+ *  The objects are built in slots of chunks of chunkSize slots, instead of being allocated one by one on the heap.
+ *  A released slot is put in a free list and reused by the next creation. The objects of a type are packed in the chunks,
+ *  so forEachAlive() walks through them linearly. The memory of the chunks is only given back
+ *  when the pool is destroyed ; the objects still alive at this moment are not destroyed, so they must be released before.
+ */
+template<class T>
+class VersionPool {
+public:
+    VersionPool(int chunkSize = 1024) : m_chunkSize(chunkSize), m_free(nullptr), m_nbAlive(0) {} /*!< Constructor of an empty pool. No memory is allocated before the first creation. */
+    ~VersionPool() { for (int i = 0; i < m_chunks.size(); i++) delete[] m_chunks.at(i); } /*!< Destructor : gives back the memory of all the chunks at once */
+
+    /*! Builds an object in a free slot with the arguments of one of its constructors, and returns it. */
+    template<typename... Args>
+    T * create(Args&&... args) {
+        if (m_free == nullptr)
+            addChunk();
+        Slot * slot = m_free;
+        m_free = slot->next;
+        T * object = new (&slot->storage) T(std::forward<Args>(args)...);
+        slot->alive = true;
+        m_nbAlive++;
+        return object;
+    }
+
+    /*! Destroys an object created by the pool and puts its slot in the free list. */
+    void release(T * object) {
+        if (object == nullptr)
+            return;
+        object->~T();
+        Slot * slot = reinterpret_cast<Slot*>(object);
+        slot->alive = false;
+        slot->next = m_free;
+        m_free = slot;
+        m_nbAlive--;
+    }
+
+    /*! Calls function on each object alive in the pool, chunk after chunk. */
+    template<class Function>
+    void forEachAlive(Function function) const {
+        for (int i = 0; i < m_chunks.size(); i++) {
+            const Slot * chunk = m_chunks.at(i);
+            for (int j = 0; j < m_chunkSize; j++)
+                if (chunk[j].alive)
+                    function(*reinterpret_cast<const T*>(&chunk[j].storage));
+        }
+    }
+
+    int getNbAlive() const { return m_nbAlive; } /*!< Returns the number of objects currently alive in the pool */
+    int getNbChunks() const { return m_chunks.size(); } /*!< Returns the number of chunks allocated by the pool */
+
+private:
+    /*! \struct Slot
+     *  \brief A slot holds either an object, or the next free slot when it is free.
+     *
+     *  The object is at the beginning of the slot, so a pointer on the object is a pointer on its slot.
+     */
+    struct Slot {
+        union {
+            typename std::aligned_storage<sizeof(T),alignof(T)>::type storage; /*!< The memory of the object */
+            Slot * next; /*!< The next free slot */
+        };
+        bool alive; /*!< True if the slot holds an object */
+    };
+
+    /*! Allocates a new chunk and puts all its slots in the free list. */
+    void addChunk() {
+        Slot * chunk = new Slot[m_chunkSize];
+        m_chunks.append(chunk);
+        for (int i = m_chunkSize - 1; i >= 0; i--) {
+            chunk[i].alive = false;
+            chunk[i].next = m_free;
+            m_free = &chunk[i];
+        }
+    }
+
+    VersionPool(const VersionPool&) = delete;
+    VersionPool& operator=(const VersionPool&) = delete;
+
+    const int m_chunkSize; /*!< Number of slots in a chunk */
+    QVector<Slot*> m_chunks; /*!< The chunks allocated by the pool */
+    Slot * m_free; /*!< The first free slot ; nullptr if all the slots are used */
+    int m_nbAlive; /*!< Number of objects currently alive in the pool */
+};
+
+#endif // VERSIONPOOL_H